@@ -7,6 +7,19 @@
 
 #include "color.h"
 #include <math.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Span blending kernels, chosen on first use
+typedef void (*blend_span_func_t)(color_abgr_t *dst, size_t count, color_abgr_t y);
+typedef void (*blend_array_func_t)(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+blend_span_func_t blend_span_func = NULL;
+blend_array_func_t blend_array_func = NULL;
 
 
 color_abgr_t color_from_rgba_int(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
@@ -45,6 +58,207 @@ color_abgr_t blend_color(color_abgr_t x, color_abgr_t y) {
 	return color_from_rgba_int((uint8_t)zr, (uint8_t)zg, (uint8_t)zb, 255);
 }
 
+#pragma mark - Span Blending
+
+// The SIMD kernels work on 16-bit lanes, where x * (255 - a) + y * a <= 65025,
+// and divide by 255 exactly with (v + 1 + (v >> 8)) >> 8, which holds for v < 65535.
+
+void blend_color_span_scalar(color_abgr_t *dst, size_t count, color_abgr_t y) {
+	// Same results as blend_color(), but the source terms are only computed once
+	uint32_t ya = (y & 0xFF000000) >> 24;
+	uint32_t xa = 255 - ya;
+	uint32_t yb = ((y & 0x00FF0000) >> 16) * ya;
+	uint32_t yg = ((y & 0x0000FF00) >> 8) * ya;
+	uint32_t yr = ((y & 0x000000FF) >> 0) * ya;
+	
+	for (size_t i = 0; i < count; i++) {
+		uint32_t x = dst[i];
+		uint32_t zb = (((x & 0x00FF0000) >> 16) * xa + yb) / 255;
+		uint32_t zg = (((x & 0x0000FF00) >> 8) * xa + yg) / 255;
+		uint32_t zr = (((x & 0x000000FF) >> 0) * xa + yr) / 255;
+		dst[i] = 0xFF000000 | (zb << 16) | (zg << 8) | zr;
+	}
+}
+
+void blend_color_array_scalar(color_abgr_t *dst, const color_abgr_t *src, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = blend_color(dst[i], src[i]);
+	}
+}
+
+#if defined(__SSE2__)
+
+// Blends 4 pixels: 8 lanes of 16 bits hold 2 pixels each for lo and hi
+#define BLEND_DIV255_EPI16(v) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((v), one), _mm_srli_epi16((v), 8)), 8)
+
+void blend_color_span_sse2(color_abgr_t *dst, size_t count, color_abgr_t y) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	uint16_t ya = (uint16_t)(y >> 24);
+	const __m128i xa = _mm_set1_epi16((short)(255 - ya));
+	const __m128i yterm = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)y), zero), _mm_set1_epi16((short)ya));
+	
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), xa), yterm);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), xa), yterm);
+		__m128i z = _mm_packus_epi16(BLEND_DIV255_EPI16(lo), BLEND_DIV255_EPI16(hi));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(z, opaque));
+	}
+	blend_color_span_scalar(dst + i, count - i, y);
+}
+
+void blend_color_array_sse2(color_abgr_t *dst, const color_abgr_t *src, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i max = _mm_set1_epi16(255);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i y_lo = _mm_unpacklo_epi8(y, zero);
+		__m128i y_hi = _mm_unpackhi_epi8(y, zero);
+		// Broadcast each pixel's alpha (lane 3) to its other lanes
+		__m128i ya_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(y_lo, 0xFF), 0xFF);
+		__m128i ya_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(y_hi, 0xFF), 0xFF);
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), _mm_sub_epi16(max, ya_lo)), _mm_mullo_epi16(y_lo, ya_lo));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), _mm_sub_epi16(max, ya_hi)), _mm_mullo_epi16(y_hi, ya_hi));
+		__m128i z = _mm_packus_epi16(BLEND_DIV255_EPI16(lo), BLEND_DIV255_EPI16(hi));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(z, opaque));
+	}
+	blend_color_array_scalar(dst + i, src + i, count - i);
+}
+
+#define BLEND_DIV255_EPI16_AVX2(v) _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16((v), one), _mm256_srli_epi16((v), 8)), 8)
+
+__attribute__((target("avx2")))
+void blend_color_span_avx2(color_abgr_t *dst, size_t count, color_abgr_t y) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	uint16_t ya = (uint16_t)(y >> 24);
+	const __m256i xa = _mm256_set1_epi16((short)(255 - ya));
+	const __m256i yterm = _mm256_mullo_epi16(_mm256_unpacklo_epi8(_mm256_set1_epi32((int)y), zero), _mm256_set1_epi16((short)ya));
+	
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), xa), yterm);
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), xa), yterm);
+		__m256i z = _mm256_packus_epi16(BLEND_DIV255_EPI16_AVX2(lo), BLEND_DIV255_EPI16_AVX2(hi));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(z, opaque));
+	}
+	blend_color_span_sse2(dst + i, count - i, y);
+}
+
+__attribute__((target("avx2")))
+void blend_color_array_avx2(color_abgr_t *dst, const color_abgr_t *src, size_t count) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i max = _mm256_set1_epi16(255);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i y_lo = _mm256_unpacklo_epi8(y, zero);
+		__m256i y_hi = _mm256_unpackhi_epi8(y, zero);
+		__m256i ya_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(y_lo, 0xFF), 0xFF);
+		__m256i ya_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(y_hi, 0xFF), 0xFF);
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_sub_epi16(max, ya_lo)), _mm256_mullo_epi16(y_lo, ya_lo));
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_sub_epi16(max, ya_hi)), _mm256_mullo_epi16(y_hi, ya_hi));
+		__m256i z = _mm256_packus_epi16(BLEND_DIV255_EPI16_AVX2(lo), BLEND_DIV255_EPI16_AVX2(hi));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(z, opaque));
+	}
+	blend_color_array_sse2(dst + i, src + i, count - i);
+}
+
+#elif defined(__ARM_NEON)
+
+// Blends one 8-bit channel of 16 pixels
+uint8x16_t blend_channel_neon(uint8x16_t x, uint8x16_t xa, uint8x16_t y, uint8x16_t ya) {
+	uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(x), vget_low_u8(xa)), vget_low_u8(y), vget_low_u8(ya));
+	uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(x), vget_high_u8(xa)), vget_high_u8(y), vget_high_u8(ya));
+	lo = vaddq_u16(vaddq_u16(lo, vdupq_n_u16(1)), vshrq_n_u16(lo, 8));
+	hi = vaddq_u16(vaddq_u16(hi, vdupq_n_u16(1)), vshrq_n_u16(hi, 8));
+	return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+void blend_color_span_neon(color_abgr_t *dst, size_t count, color_abgr_t y) {
+	const uint8x16_t ya = vdupq_n_u8((uint8_t)(y >> 24));
+	const uint8x16_t xa = vmvnq_u8(ya);
+	const uint8x16_t yr = vdupq_n_u8((uint8_t)(y >> 0));
+	const uint8x16_t yg = vdupq_n_u8((uint8_t)(y >> 8));
+	const uint8x16_t yb = vdupq_n_u8((uint8_t)(y >> 16));
+	
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		// De-interleave into r, g, b, a planes
+		uint8x16x4_t x = vld4q_u8((const uint8_t *)(dst + i));
+		x.val[0] = blend_channel_neon(x.val[0], xa, yr, ya);
+		x.val[1] = blend_channel_neon(x.val[1], xa, yg, ya);
+		x.val[2] = blend_channel_neon(x.val[2], xa, yb, ya);
+		x.val[3] = vdupq_n_u8(255);
+		vst4q_u8((uint8_t *)(dst + i), x);
+	}
+	blend_color_span_scalar(dst + i, count - i, y);
+}
+
+void blend_color_array_neon(color_abgr_t *dst, const color_abgr_t *src, size_t count) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16x4_t x = vld4q_u8((const uint8_t *)(dst + i));
+		uint8x16x4_t y = vld4q_u8((const uint8_t *)(src + i));
+		uint8x16_t xa = vmvnq_u8(y.val[3]);
+		x.val[0] = blend_channel_neon(x.val[0], xa, y.val[0], y.val[3]);
+		x.val[1] = blend_channel_neon(x.val[1], xa, y.val[1], y.val[3]);
+		x.val[2] = blend_channel_neon(x.val[2], xa, y.val[2], y.val[3]);
+		x.val[3] = vdupq_n_u8(255);
+		vst4q_u8((uint8_t *)(dst + i), x);
+	}
+	blend_color_array_scalar(dst + i, src + i, count - i);
+}
+
+#endif
+
+void blend_select_kernels(void) {
+#if defined(__SSE2__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		blend_span_func = blend_color_span_avx2;
+		blend_array_func = blend_color_array_avx2;
+	} else {
+		blend_span_func = blend_color_span_sse2;
+		blend_array_func = blend_color_array_sse2;
+	}
+#elif defined(__ARM_NEON)
+	blend_span_func = blend_color_span_neon;
+	blend_array_func = blend_color_array_neon;
+#else
+	blend_span_func = blend_color_span_scalar;
+	blend_array_func = blend_color_array_scalar;
+#endif
+}
+
+void blend_color_span(color_abgr_t *dst, size_t count, color_abgr_t y) {
+	// Blends y on top of count pixels
+	if (!blend_span_func) blend_select_kernels();
+	blend_span_func(dst, count, y);
+}
+
+void blend_color_array(color_abgr_t *dst, const color_abgr_t *src, size_t count) {
+	// Blends each src pixel on top of the matching dst pixel
+	if (!blend_array_func) blend_select_kernels();
+	blend_array_func(dst, src, count);
+}
+
+#pragma mark - HSV
+
 color_abgr_t color_from_hsv(double h, double s, double v, double a) {
 	// Adapted from: https://stackoverflow.com/questions/3018313/algorithm-to-convert-rgb-to-hsv-and-hsv-to-rgb-in-range-0-255-for-both
 	
@@ -8,6 +8,7 @@
 #ifndef color_h
 #define color_h
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -20,6 +21,24 @@ typedef uint32_t color_abgr_t;
 
 color_abgr_t blend_color(color_abgr_t x, color_abgr_t y);
 
+// Span blending: SIMD where available, with results identical to blend_color()
+void blend_color_span(color_abgr_t *dst, size_t count, color_abgr_t y); // One color over count pixels
+void blend_color_array(color_abgr_t *dst, const color_abgr_t *src, size_t count); // Each src pixel over its dst pixel
+
+// The kernels behind blend_color_span() and blend_color_array(), for checks and benchmarks
+void blend_color_span_scalar(color_abgr_t *dst, size_t count, color_abgr_t y);
+void blend_color_array_scalar(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+#if defined(__SSE2__)
+void blend_color_span_sse2(color_abgr_t *dst, size_t count, color_abgr_t y);
+void blend_color_array_sse2(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+// Only on CPUs with AVX2
+void blend_color_span_avx2(color_abgr_t *dst, size_t count, color_abgr_t y);
+void blend_color_array_avx2(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+#elif defined(__ARM_NEON)
+void blend_color_span_neon(color_abgr_t *dst, size_t count, color_abgr_t y);
+void blend_color_array_neon(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+#endif
+
 color_abgr_t color_from_hsv(double h, double s, double v, double a);
 
 #endif /* color_h */
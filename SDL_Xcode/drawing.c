@@ -7,23 +7,59 @@
 
 #include "drawing.h"
 #include "color.h"
+#include "memfill.h"
+#include "profiler.h"
 #include "mesh.h"
+#include "tiles.h"
 #include "vector.h"
 
-#include <SDL2/SDL.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#ifndef HEADLESS
+#include <SDL2/SDL.h>
 
 // Globals for SDL
 SDL_Window* sdl_window;
 SDL_Rect window_rect;
 SDL_Renderer* sdl_renderer;
 SDL_Texture* sdl_texture;
+
+// Zero-copy mode: frames are drawn straight into a locked streaming texture.
+// Two textures take turns, so one can be drawn into while the other is presented.
+bool zero_copy = false;
+SDL_Texture* sdl_textures[2];
+int sdl_texture_index = 0;
+bool sdl_texture_locked = false;
+#endif
+
+// Frame buffer. screen_pixels is where drawing goes: normally frame_buffer,
+// but a locked texture while drawing directly into it. Rows are screen_stride
+// pixels apart.
+uint32_t* frame_buffer;
 uint32_t* screen_pixels;
 int screen_w;
 int screen_h;
+int screen_stride;
 size_t screen_pitch;
 
+// Depth buffer: smaller values are closer. Each 8x8 block also keeps an upper
+// bound of its depth values, so hidden blocks of a triangle can be skipped at once.
+depth_format_t depth_format = DEPTH_NONE;
+void *depth_buffer = NULL;
+float *depth_block_max = NULL;
+int depth_blocks_w = 0;
+int depth_blocks_h = 0;
+
+// Rasterizer clip rectangle. Each thread has its own, so tiles can be drawn in parallel.
+_Thread_local clip_rect_t raster_clip = { 0, 0, 0, 0 };
+
+// Subpixel raster: coordinates snap to 28.4 fixed point and edges are tested with integers
+bool subpixel_raster = false;
+
 // Drawing context
 color_abgr_t line_color;
 color_abgr_t fill_color;
@@ -33,6 +69,28 @@ vec2_t cursor;
 mat3_t view_transform_2d;
 mat4_t camera_transform_3d;
 mat4_t perspective_matrix;
+mat4_t viewport_matrix;
+
+// Line endpoints are converted to int, so anything farther out than this is dropped
+#define LINE_COORD_LIMIT (1048576.0f)
+
+// Triangles are rasterized in square blocks of this many pixels
+#define TRIANGLE_BLOCK_SIZE (8)
+
+// Near and far planes
+#define Z_NEAR (0.3f)
+#define Z_FAR (1000.0f)
+
+// Geometry is clipped to this many pixels beyond each side of the screen.
+// Triangles inside the guard band are left for the rasterizer to clip.
+#define GUARD_BAND (1024.0f)
+
+// Near, far, left, right, top and bottom
+#define CLIP_PLANE_COUNT (6)
+
+// Frame dumping
+const char *frame_dump_path = NULL;
+int frame_dump_index = 0;
 
 
 #pragma mark - SDL Interface
@@ -50,12 +108,16 @@ void init_projection(void) {
 	vec3_t ct = { .x = 0, .y = 0, .z = 5 };
 	camera_transform_3d = mat4_translate(mat4_identity(), ct);
 	
-	// Perspective matrix
+	// Perspective matrix. A 90 degree field of view matches the view transform,
+	// which maps y / z = 1 to the bottom of the screen.
 	float aspect = (float)screen_h / (float)screen_w;
-	float fov = 60.0f * (float)M_PI / 180.0f;
-	perspective_matrix = mat4_perspective_matrix(fov, aspect, 0.3f, 1000.0f);
+	float fov = 90.0f * (float)M_PI / 180.0f;
+	perspective_matrix = mat4_perspective_matrix(fov, aspect, Z_NEAR, Z_FAR);
+	viewport_matrix = mat4_viewport_matrix((float)screen_w, (float)screen_h);
 }
 
+#ifndef HEADLESS
+
 bool init_screen(int width, int height, int scale) {
 	//fprintf(stdout, "initialize_windowing_system().\n");
 	
@@ -66,9 +128,6 @@ bool init_screen(int width, int height, int scale) {
 	}
 	
 	// Store dimensions in globals
-	screen_w = width;
-	screen_h = height;
-	screen_pitch = (size_t)width * sizeof(uint32_t);
 	window_rect.x = window_rect.y = 0;
 	window_rect.w = width * scale;
 	window_rect.h = height * scale;
@@ -87,12 +146,7 @@ bool init_screen(int width, int height, int scale) {
 	}
 
 	// Allocate frame buffer
-	screen_pixels = (uint32_t*)malloc((size_t)(height) * screen_pitch);
-	if (!screen_pixels) {
-		fprintf(stderr, "malloc() failed!\n");
-		return false;
-	}
-	fill_screen(ABGR_BLACK);
+	if (!init_offscreen(width, height)) return false;
 	
 	// Set up the renderer
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, 0); // Use no interpolation
@@ -103,33 +157,305 @@ bool init_screen(int width, int height, int scale) {
 
 	// Debug logging: window * texture size
 	fprintf(stdout, "Created window (%dx%d) and texture (%dx%d).\n", window_rect.w, window_rect.h, screen_w, screen_h);
-	
-	// Set up default transforms
-	init_projection();
 
 	return true;
 }
 
 void destroy_screen(void) {
-	free(screen_pixels);
+	enable_zero_copy(false);
+	destroy_offscreen();
 	SDL_DestroyTexture(sdl_texture);
 	SDL_DestroyRenderer(sdl_renderer);
 	SDL_DestroyWindow(sdl_window);
 	SDL_Quit();
 }
 
+bool enable_zero_copy(bool enable) {
+	if (enable == zero_copy) return true;
+	if (enable) {
+		sdl_textures[0] = sdl_texture;
+		sdl_textures[1] = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, screen_w, screen_h);
+		if (!sdl_textures[1]) {
+			fprintf(stderr, "SDL_CreateTexture() failed: %s\n", SDL_GetError());
+			return false;
+		}
+		sdl_texture_index = 0;
+	} else {
+		if (sdl_texture_locked) {
+			SDL_UnlockTexture(sdl_textures[sdl_texture_index]);
+			sdl_texture_locked = false;
+		}
+		SDL_DestroyTexture(sdl_textures[1]);
+		sdl_textures[1] = NULL;
+		screen_pixels = frame_buffer;
+		screen_stride = screen_w;
+	}
+	zero_copy = enable;
+	return true;
+}
+
+void begin_frame(void) {
+	// In zero-copy mode, point screen_pixels at the next texture
+	if (!zero_copy || sdl_texture_locked) return;
+	
+	void *pixels;
+	int pitch;
+	if (SDL_LockTexture(sdl_textures[sdl_texture_index], NULL, &pixels, &pitch) != 0) {
+		fprintf(stderr, "SDL_LockTexture() failed: %s\n", SDL_GetError());
+		return;
+	}
+	sdl_texture_locked = true;
+	if (pitch % (int)sizeof(uint32_t) != 0) {
+		// Rows do not start on whole pixels, so go back to copying the frame buffer
+		enable_zero_copy(false);
+		return;
+	}
+	screen_pixels = pixels;
+	screen_stride = pitch / (int)sizeof(uint32_t);
+}
+
 void render_to_screen(void) {
-	// Render frame buffer
-	SDL_UpdateTexture(sdl_texture, NULL, screen_pixels, (int)screen_pitch);
-	SDL_RenderCopy(sdl_renderer, sdl_texture, NULL, &window_rect);
+	// Finish any binned drawing
+	uint64_t start_time = profile_now();
+	tiles_flush();
+	profile_add(PROFILE_TILES, start_time);
+	
+	SDL_Texture *texture = sdl_texture;
+	start_time = profile_now();
+	if (sdl_texture_locked) {
+		// Zero-copy: the frame is already in the texture
+		texture = sdl_textures[sdl_texture_index];
+		SDL_UnlockTexture(texture);
+		sdl_texture_locked = false;
+		screen_pixels = frame_buffer;
+		screen_stride = screen_w;
+		sdl_texture_index ^= 1;
+	} else {
+		// Copy frame buffer
+		SDL_UpdateTexture(texture, NULL, screen_pixels, (int)screen_pitch);
+	}
+	profile_add(PROFILE_UPLOAD, start_time);
+	
+	start_time = profile_now();
+	SDL_RenderCopy(sdl_renderer, texture, NULL, &window_rect);
 	SDL_RenderPresent(sdl_renderer);
+	profile_add(PROFILE_PRESENT, start_time);
+}
+
+#else
+
+bool init_screen(int width, int height, int scale) {
+	// Headless version: no window, so the scale is ignored
+	(void)scale;
+	return init_offscreen(width, height);
+}
+
+void destroy_screen(void) {
+	destroy_offscreen();
+}
+
+bool enable_zero_copy(bool enable) {
+	// Headless version: there is no texture, so frames always stay in the frame buffer
+	return !enable;
+}
+
+void begin_frame(void) {
+}
+
+void render_to_screen(void) {
+	// Headless version: optionally write each frame to disk
+	uint64_t start_time = profile_now();
+	tiles_flush();
+	profile_add(PROFILE_TILES, start_time);
+	if (frame_dump_path) {
+		char path[1024];
+		snprintf(path, sizeof(path), frame_dump_path, frame_dump_index);
+		start_time = profile_now();
+		save_screen_to_file(path);
+		profile_add(PROFILE_UPLOAD, start_time);
+	}
+	frame_dump_index++;
+}
+
+#endif
+
+#pragma mark - Offscreen Interface
+
+bool init_offscreen(int width, int height) {
+	// Store dimensions in globals
+	screen_w = width;
+	screen_h = height;
+	screen_pitch = (size_t)width * sizeof(uint32_t);
+	raster_clip = screen_rect();
+
+	// Allocate frame buffer
+	frame_buffer = (uint32_t*)malloc((size_t)(height) * screen_pitch);
+	screen_pixels = frame_buffer;
+	screen_stride = width;
+	if (!frame_buffer) {
+		fprintf(stderr, "malloc() failed!\n");
+		return false;
+	}
+	fill_screen(ABGR_BLACK);
+
+	// Set up default transforms
+	init_projection();
+
+	return true;
+}
+
+void destroy_offscreen(void) {
+	destroy_tiles();
+	destroy_depth_buffer();
+	free(frame_buffer);
+	frame_buffer = NULL;
+	screen_pixels = NULL;
+}
+
+void set_frame_dump_path(const char *path_format) {
+	// The format takes the frame number, e.g. "frame_%04d.ppm". Pass NULL to stop dumping.
+	frame_dump_path = path_format;
+	frame_dump_index = 0;
+}
+
+bool save_screen_to_file(const char *path) {
+	// Writes the frame buffer as a binary PPM, which needs no image library.
+	tiles_flush();
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "fopen(%s) failed!\n", path);
+		return false;
+	}
+	
+	uint8_t *row = malloc((size_t)screen_w * 3);
+	if (!row) {
+		fclose(file);
+		return false;
+	}
+	
+	fprintf(file, "P6\n%d %d\n255\n", screen_w, screen_h);
+	for (int y = 0; y < screen_h; y++) {
+		const uint32_t *src = screen_pixels + (size_t)y * (size_t)screen_stride;
+		for (int x = 0; x < screen_w; x++) {
+			// Pixel format is ABGR, so red is in the low byte
+			row[x * 3 + 0] = (uint8_t)(src[x] >> 0);
+			row[x * 3 + 1] = (uint8_t)(src[x] >> 8);
+			row[x * 3 + 2] = (uint8_t)(src[x] >> 16);
+		}
+		fwrite(row, 3, (size_t)screen_w, file);
+	}
+	
+	free(row);
+	bool ok = (ferror(file) == 0);
+	if (fclose(file) != 0) ok = false;
+	return ok;
+}
+
+#pragma mark - Depth Buffer
+
+bool init_depth_buffer(depth_format_t format) {
+	// Call after the screen is set up. DEPTH_NONE turns depth testing off.
+	destroy_depth_buffer();
+	if (format == DEPTH_NONE) return true;
+	
+	size_t pixel_size = (format == DEPTH_16)? sizeof(uint16_t) : sizeof(float);
+	depth_blocks_w = (screen_w + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE;
+	depth_blocks_h = (screen_h + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE;
+	depth_buffer = malloc((size_t)screen_w * (size_t)screen_h * pixel_size);
+	depth_block_max = malloc((size_t)depth_blocks_w * (size_t)depth_blocks_h * sizeof(float));
+	if (!depth_buffer || !depth_block_max) {
+		fprintf(stderr, "malloc() failed!\n");
+		destroy_depth_buffer();
+		return false;
+	}
+	depth_format = format;
+	clear_depth_buffer();
+	return true;
+}
+
+void destroy_depth_buffer(void) {
+	free(depth_buffer);
+	free(depth_block_max);
+	depth_buffer = NULL;
+	depth_block_max = NULL;
+	depth_format = DEPTH_NONE;
+}
+
+uint32_t float_bits(float f) {
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+void clear_depth_buffer(void) {
+	// Clears to the far plane, using the same fill kernels as fill_screen()
+	if (depth_format == DEPTH_NONE) return;
+	if (tiles_enabled() && tiles_add_clear_depth()) return;
+	size_t count = (size_t)screen_w * (size_t)screen_h;
+	switch (depth_format) {
+	case DEPTH_16:
+		memfill16(depth_buffer, 0xFFFF, count);
+		break;
+	case DEPTH_32F:
+		memfill32(depth_buffer, float_bits(1.0f), count);
+		break;
+	case DEPTH_NONE:
+		return;
+	}
+	memfill32((uint32_t *)depth_block_max, float_bits(1.0f), (size_t)depth_blocks_w * (size_t)depth_blocks_h);
+}
+
+void clear_depth_rect(clip_rect_t r) {
+	// Clears part of the depth buffer. The rectangle should be aligned to the
+	// 8x8 depth blocks, or the block bounds will be left as they are.
+	for (int y = r.y0; y < r.y1; y++) {
+		size_t offset = (size_t)y * (size_t)screen_w + (size_t)r.x0;
+		size_t count = (size_t)(r.x1 - r.x0);
+		if (depth_format == DEPTH_16) {
+			memfill16((uint16_t *)depth_buffer + offset, 0xFFFF, count);
+		} else if (depth_format == DEPTH_32F) {
+			memfill32((uint32_t *)depth_buffer + offset, float_bits(1.0f), count);
+		}
+	}
+	if (depth_format == DEPTH_NONE) return;
+	
+	const int bs = TRIANGLE_BLOCK_SIZE;
+	int bx0 = (r.x0 + bs - 1) / bs, bx1 = (r.x1 == screen_w)? depth_blocks_w : r.x1 / bs;
+	int by0 = (r.y0 + bs - 1) / bs, by1 = (r.y1 == screen_h)? depth_blocks_h : r.y1 / bs;
+	for (int by = by0; by < by1; by++) {
+		if (bx1 > bx0) {
+			memfill32((uint32_t *)depth_block_max + by * depth_blocks_w + bx0, float_bits(1.0f), (size_t)(bx1 - bx0));
+		}
+	}
+}
+
+#pragma mark - Clipping
+
+clip_rect_t screen_rect(void) {
+	clip_rect_t r = { 0, 0, screen_w, screen_h };
+	return r;
+}
+
+void set_clip_rect(clip_rect_t r) {
+	// Clips the rasterizer on the calling thread. Must lie within the screen.
+	raster_clip = r;
 }
 
 #pragma mark - Drawing 2D
 
 void fill_screen(color_abgr_t color) {
-	for (int i = 0; i < screen_w * screen_h; i++) {
-		screen_pixels[i] = color;
+	if (tiles_enabled() && tiles_add_clear(color)) return;
+	if (screen_stride == screen_w) {
+		memfill32(screen_pixels, color, (size_t)screen_w * (size_t)screen_h);
+	} else {
+		clear_rect(screen_rect(), color);
+	}
+}
+
+void clear_rect(clip_rect_t r, color_abgr_t color) {
+	uint32_t *row = screen_pixels + (ptrdiff_t)r.y0 * screen_stride + r.x0;
+	for (int y = r.y0; y < r.y1; y++, row += screen_stride) {
+		memfill32(row, color, (size_t)(r.x1 - r.x0));
 	}
 }
 
@@ -138,25 +464,140 @@ void move_to(vec2_t a) {
 }
 
 void line_to(vec2_t a) {
-	float dx = a.x - cursor.x;
-	float dy = a.y - cursor.y;
-	float steps = fabsf(dx) > fabsf(dy)? fabsf(dx) : fabsf(dy);
-	float sx = dx / steps;
-	float sy = dy / steps;
-	float x = cursor.x;
-	float y = cursor.y;
-	for (float i = 0.0f; i <= steps; i++) {
-		set_pixel((int)floorf(x), (int)floorf(y), line_color);
-		x += sx;
-		y += sy;
+	// Endpoints snap to the pixel that contains them. Coordinates beyond the
+	// limit (e.g. points projected from behind the camera) are not drawn.
+	if (fabsf(cursor.x) < LINE_COORD_LIMIT && fabsf(cursor.y) < LINE_COORD_LIMIT &&
+		fabsf(a.x) < LINE_COORD_LIMIT && fabsf(a.y) < LINE_COORD_LIMIT) {
+		if (subpixel_raster) {
+			point_fixed_t p0 = point_to_fixed(cursor), p1 = point_to_fixed(a);
+			if (!tiles_enabled() || !tiles_add_line_fixed(p0, p1, line_color)) {
+				draw_line_fixed(p0, p1, line_color);
+			}
+			cursor = a;
+			return;
+		}
+		int x0 = (int)floorf(cursor.x), y0 = (int)floorf(cursor.y);
+		int x1 = (int)floorf(a.x), y1 = (int)floorf(a.y);
+		if (!tiles_enabled() || !tiles_add_line(x0, y0, x1, y1, line_color)) {
+			draw_line(x0, y0, x1, y1, line_color);
+		}
 	}
 	cursor = a;
 }
 
+void draw_line(int x0, int y0, int x1, int y1, color_abgr_t color) {
+	// Integer Bresenham line, including both endpoints.
+	// Pixel i along the major axis is offset on the minor axis by
+	// k(i) = floor((2 * i * minor_len + major_len) / (2 * major_len)),
+	// so the segment is clipped to the clip rectangle by solving for the range of i
+	// up front. The clipped line hits exactly the same pixels as the unclipped one.
+	int dx = x1 - x0;
+	int dy = y1 - y0;
+	int adx = abs(dx);
+	int ady = abs(dy);
+	bool x_major = adx >= ady;
+	
+	int major_len = x_major? adx : ady;
+	int minor_len = x_major? ady : adx;
+	int major0 = x_major? x0 : y0;
+	int minor0 = x_major? y0 : x0;
+	int major_dir = (x_major? dx : dy) < 0? -1 : 1;
+	int minor_dir = (x_major? dy : dx) < 0? -1 : 1;
+	int major_min = x_major? raster_clip.x0 : raster_clip.y0;
+	int minor_min = x_major? raster_clip.y0 : raster_clip.x0;
+	int major_max = (x_major? raster_clip.x1 : raster_clip.y1) - 1;
+	int minor_max = (x_major? raster_clip.y1 : raster_clip.x1) - 1;
+	
+	int64_t two_major = 2 * (int64_t)major_len;
+	int64_t two_minor = 2 * (int64_t)minor_len;
+	
+	// Clip on the major axis
+	int64_t i_lo = 0, i_hi = major_len;
+	int64_t lo = (major_dir > 0)? (int64_t)major_min - major0 : (int64_t)major0 - major_max;
+	int64_t hi = (major_dir > 0)? (int64_t)major_max - major0 : (int64_t)major0 - major_min;
+	if (lo > i_lo) i_lo = lo;
+	if (hi < i_hi) i_hi = hi;
+	if (i_lo > i_hi) return;
+
+	// Clip on the minor axis: k(i) must stay within [k_lo, k_hi]
+	int64_t k_lo = (minor_dir > 0)? (int64_t)minor_min - minor0 : (int64_t)minor0 - minor_max;
+	int64_t k_hi = (minor_dir > 0)? (int64_t)minor_max - minor0 : (int64_t)minor0 - minor_min;
+	if (k_hi < 0 || k_lo > minor_len) return;
+	if (minor_len > 0) {
+		if (k_lo > 0) {
+			lo = ((2 * k_lo - 1) * major_len + two_minor - 1) / two_minor;
+			if (lo > i_lo) i_lo = lo;
+		}
+		if (k_hi < minor_len) {
+			hi = ((2 * k_hi + 1) * major_len + two_minor - 1) / two_minor - 1;
+			if (hi < i_hi) i_hi = hi;
+		}
+	}
+	if (i_lo > i_hi) return;
+	
+	// Bresenham state at the first visible pixel
+	int64_t num = i_lo * two_minor + major_len;
+	int64_t k = (major_len > 0)? num / two_major : 0;
+	int64_t err = num - k * two_major;
+	
+	int x = (int)(x_major? major0 + major_dir * i_lo : minor0 + minor_dir * k);
+	int y = (int)(x_major? minor0 + minor_dir * k : major0 + major_dir * i_lo);
+	ptrdiff_t step_x = (x_major? major_dir : minor_dir);
+	ptrdiff_t step_y = (ptrdiff_t)(x_major? minor_dir : major_dir) * screen_stride;
+	ptrdiff_t major_step = x_major? step_x : step_y;
+	ptrdiff_t minor_step = x_major? step_y : step_x;
+	
+	uint32_t *p = screen_pixels + (ptrdiff_t)y * screen_stride + x;
+	int64_t count = i_hi - i_lo + 1;
+	
+	if ((color & 0xFF000000) == 0xFF000000) {
+		// Opaque
+		for (int64_t i = 0; i < count; i++) {
+			*p = color;
+			p += major_step;
+			err += two_minor;
+			if (err >= two_major) {
+				err -= two_major;
+				p += minor_step;
+			}
+		}
+	} else {
+		// Blended
+		for (int64_t i = 0; i < count; i++) {
+			*p = blend_color(*p, color);
+			p += major_step;
+			err += two_minor;
+			if (err >= two_major) {
+				err -= two_major;
+				p += minor_step;
+			}
+		}
+	}
+}
+
 void fill_rect(int x, int y, int w, int h) {
-	for (int y1 = 0; y1 < h; y1++) {
-		for (int x1 = 0; x1 < w; x1++) {
-			set_pixel(x + x1, y + y1, fill_color);
+	if (!tiles_enabled() || !tiles_add_rect(x, y, w, h, fill_color)) {
+		draw_rect(x, y, w, h, fill_color);
+	}
+}
+
+void draw_rect(int x, int y, int w, int h, color_abgr_t color) {
+	// Clip once, then fill whole rows
+	int x0 = (x > raster_clip.x0)? x : raster_clip.x0;
+	int y0 = (y > raster_clip.y0)? y : raster_clip.y0;
+	int x1 = (x + w < raster_clip.x1)? x + w : raster_clip.x1;
+	int y1 = (y + h < raster_clip.y1)? y + h : raster_clip.y1;
+	if (x0 >= x1 || y0 >= y1) return;
+	
+	size_t row_len = (size_t)(x1 - x0);
+	uint32_t *row = screen_pixels + (ptrdiff_t)y0 * screen_stride + x0;
+	if ((color & 0xFF000000) == 0xFF000000) {
+		for (int y2 = y0; y2 < y1; y2++, row += screen_stride) {
+			memfill32(row, color, row_len);
+		}
+	} else {
+		for (int y2 = y0; y2 < y1; y2++, row += screen_stride) {
+			blend_color_span(row, row_len, color);
 		}
 	}
 }
@@ -165,12 +606,532 @@ void fill_centered_rect(int x, int y, int w, int h) {
 	fill_rect(x - w / 2, y - h / 2, w, h);
 }
 
+typedef struct {
+	float a, b, c; // w(x, y) = a * x + b * y + c
+	bool top_left; // Pixels exactly on the edge are only drawn for top or left edges
+} edge_t;
+
+edge_t edge_make(vec2_t v0, vec2_t v1) {
+	// Positive on the inside of a triangle with positive area
+	edge_t e;
+	e.a = v0.y - v1.y;
+	e.b = v1.x - v0.x;
+	e.c = v0.x * v1.y - v0.y * v1.x;
+	// With y pointing down, a top edge is horizontal and goes right,
+	// and a left edge goes up.
+	e.top_left = (e.a == 0.0f && e.b > 0.0f) || e.a > 0.0f;
+	return e;
+}
+
+float edge_eval(const edge_t *e, float x, float y) {
+	// Always evaluated the same way, so that the two triangles sharing an edge
+	// get exactly opposite values and the edge has no gaps or double hits.
+	return e->a * x + (e->b * y + e->c);
+}
+
+bool edge_inside(const edge_t *e, float w) {
+	return w > 0.0f || (w == 0.0f && e->top_left);
+}
+
+void fill_span(uint32_t *row, int x0, int x1, color_abgr_t color) {
+	// Fills pixels x0 up to but not including x1
+	if (x0 >= x1) return;
+	if ((color & 0xFF000000) == 0xFF000000) {
+		memfill32(row + x0, color, (size_t)(x1 - x0));
+	} else {
+		blend_color_span(row + x0, (size_t)(x1 - x0), color);
+	}
+}
+
+bool depth_test_row(int x0, int x1, int y, float d_row, float d_dx, color_abgr_t color) {
+	// Tests pixels x0 to x1 - 1 against the depth buffer and fills the runs that pass.
+	// Returns true if every pixel passed.
+	bool write = (color & 0xFF000000) == 0xFF000000;
+	bool all_passed = true;
+	int run_start = -1;
+	uint32_t *row = screen_pixels + (ptrdiff_t)y * screen_stride;
+	size_t offset = (size_t)y * (size_t)screen_w;
+	
+	for (int x = x0; x <= x1; x++) {
+		bool pass = false;
+		if (x < x1) {
+			float d = d_row + d_dx * (float)x;
+			if (depth_format == DEPTH_16) {
+				uint16_t *z = (uint16_t *)depth_buffer + offset + (size_t)x;
+				// Quantize only depths in range, so NaN never reaches the cast
+				if (d >= 0.0f && d <= 1.0f) {
+					uint16_t dq = (uint16_t)(d * 65535.0f + 0.5f);
+					pass = dq < *z;
+					if (pass && write) *z = dq;
+				}
+			} else {
+				float *z = (float *)depth_buffer + offset + (size_t)x;
+				pass = d >= 0.0f && d < *z;
+				if (pass && write) *z = d;
+			}
+			if (!pass) all_passed = false;
+		}
+		if (pass) {
+			if (run_start < 0) run_start = x;
+		} else if (run_start >= 0) {
+			fill_span(row, run_start, x, color);
+			run_start = -1;
+		}
+	}
+	return all_passed;
+}
+
+void draw_triangle(vec2_t a, vec2_t b, vec2_t c, const float *depths, color_abgr_t color) {
+	// Half-space rasterizer: a pixel is drawn if its center is inside all three edges.
+	// The bounding box is walked in blocks, so blocks fully outside an edge are skipped
+	// and blocks fully inside are filled without testing each pixel.
+	// If depths are given, the depth of vertices a, b and c are interpolated and
+	// each block is first tested against its depth bound.
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (!(fabsf(area) > 0.0f)) return;
+	float da = 0, db = 0, dc = 0;
+	if (depths) {
+		da = depths[0];
+		db = depths[1];
+		dc = depths[2];
+	}
+	if (area < 0.0f) {
+		vec2_t t = b;
+		b = c;
+		c = t;
+		float dt = db;
+		db = dc;
+		dc = dt;
+		area = -area;
+	}
+	bool use_depth = depths && depth_format != DEPTH_NONE;
+	bool write_depth = (color & 0xFF000000) == 0xFF000000;
+	
+	// Bounding box, clipped to the clip rectangle
+	float min_x = fminf(a.x, fminf(b.x, c.x));
+	float max_x = fmaxf(a.x, fmaxf(b.x, c.x));
+	float min_y = fminf(a.y, fminf(b.y, c.y));
+	float max_y = fmaxf(a.y, fmaxf(b.y, c.y));
+	clip_rect_t clip = raster_clip;
+	if (!(max_x >= (float)clip.x0 && max_y >= (float)clip.y0 && min_x < (float)clip.x1 && min_y < (float)clip.y1)) return;
+	int x0 = (min_x > (float)clip.x0)? (int)floorf(min_x) : clip.x0;
+	int y0 = (min_y > (float)clip.y0)? (int)floorf(min_y) : clip.y0;
+	int x1 = (max_x < (float)(clip.x1 - 1))? (int)floorf(max_x) : clip.x1 - 1;
+	int y1 = (max_y < (float)(clip.y1 - 1))? (int)floorf(max_y) : clip.y1 - 1;
+	
+	edge_t e[3] = { edge_make(b, c), edge_make(c, a), edge_make(a, b) };
+	const int bs = TRIANGLE_BLOCK_SIZE;
+	
+	// Depth plane: d(x, y) = d_dx * x + d_dy * y + d_c, from the barycentric weights
+	float d_dx = (e[0].a * da + e[1].a * db + e[2].a * dc) / area;
+	float d_dy = (e[0].b * da + e[1].b * db + e[2].b * dc) / area;
+	float d_c = (e[0].c * da + e[1].c * db + e[2].c * dc) / area;
+	
+	for (int by = y0 - y0 % bs; by <= y1; by += bs) {
+		for (int bx = x0 - x0 % bs; bx <= x1; bx += bs) {
+			// Pixel range of this block within the bounding box
+			int px0 = (bx > x0)? bx : x0;
+			int py0 = (by > y0)? by : y0;
+			int px1 = (bx + bs - 1 < x1)? bx + bs - 1 : x1;
+			int py1 = (by + bs - 1 < y1)? by + bs - 1 : y1;
+			
+			// Test the pixel centers at the block corners against each edge
+			float cx0 = (float)px0 + 0.5f, cx1 = (float)px1 + 0.5f;
+			float cy0 = (float)py0 + 0.5f, cy1 = (float)py1 + 0.5f;
+			bool skip = false;
+			bool full = true;
+			for (int i = 0; i < 3; i++) {
+				float w00 = edge_eval(&e[i], cx0, cy0);
+				float w10 = edge_eval(&e[i], cx1, cy0);
+				float w01 = edge_eval(&e[i], cx0, cy1);
+				float w11 = edge_eval(&e[i], cx1, cy1);
+				if (w00 < 0.0f && w10 < 0.0f && w01 < 0.0f && w11 < 0.0f) {
+					skip = true;
+					break;
+				}
+				if (!(w00 > 0.0f && w10 > 0.0f && w01 > 0.0f && w11 > 0.0f)) {
+					full = false;
+				}
+			}
+			if (skip) continue;
+			
+			// Early depth rejection: skip the block if the nearest depth of the
+			// triangle over it is behind everything already drawn there.
+			float *block_max = NULL;
+			float block_far = 0.0f;
+			if (use_depth) {
+				block_max = &depth_block_max[(by / bs) * depth_blocks_w + (bx / bs)];
+				float d00 = d_dx * cx0 + d_dy * cy0 + d_c;
+				float d10 = d_dx * cx1 + d_dy * cy0 + d_c;
+				float d01 = d_dx * cx0 + d_dy * cy1 + d_c;
+				float d11 = d_dx * cx1 + d_dy * cy1 + d_c;
+				float block_near = fminf(fminf(d00, d10), fminf(d01, d11));
+				block_far = fmaxf(fmaxf(d00, d10), fmaxf(d01, d11));
+				if (block_near >= *block_max) continue;
+			}
+			
+			uint32_t *row = screen_pixels + (ptrdiff_t)py0 * screen_stride;
+			if (full && !use_depth) {
+				for (int y = py0; y <= py1; y++, row += screen_stride) {
+					fill_span(row, px0, px1 + 1, color);
+				}
+				continue;
+			}
+			
+			// The covered pixels of a row are contiguous, so find the span.
+			// The y terms are computed once per row and the x terms step along the row.
+			bool all_passed = full;
+			for (int y = py0; y <= py1; y++, row += screen_stride) {
+				float cy = (float)y + 0.5f;
+				int span_start = px0;
+				int span_end = px1 + 1;
+				if (!full) {
+					float r0 = e[0].b * cy + e[0].c;
+					float r1 = e[1].b * cy + e[1].c;
+					float r2 = e[2].b * cy + e[2].c;
+					span_start = -1;
+					span_end = -1;
+					float cx = cx0;
+					for (int x = px0; x <= px1; x++, cx += 1.0f) {
+						if (edge_inside(&e[0], e[0].a * cx + r0) &&
+							edge_inside(&e[1], e[1].a * cx + r1) &&
+							edge_inside(&e[2], e[2].a * cx + r2)) {
+							if (span_start < 0) span_start = x;
+							span_end = x + 1;
+						} else if (span_start >= 0) {
+							break;
+						}
+					}
+					if (span_start < 0) continue;
+				}
+				if (use_depth) {
+					float d_row = d_dy * cy + d_c + d_dx * 0.5f;
+					if (!depth_test_row(span_start, span_end, y, d_row, d_dx, color)) {
+						all_passed = false;
+					}
+				} else {
+					fill_span(row, span_start, span_end, color);
+				}
+			}
+			
+			// A whole block covered by this triangle now has the triangle's depth bound
+			if (use_depth && all_passed && write_depth && px0 == bx && py0 == by &&
+				px1 == ((bx + bs <= screen_w)? bx + bs - 1 : screen_w - 1) &&
+				py1 == ((by + bs <= screen_h)? by + bs - 1 : screen_h - 1)) {
+				*block_max = fminf(*block_max, block_far);
+			}
+		}
+	}
+}
+
+#pragma mark - Subpixel Raster
+
+void enable_subpixel_raster(bool enable) {
+	subpixel_raster = enable;
+}
+
+bool subpixel_raster_enabled(void) {
+	return subpixel_raster;
+}
+
+int32_t coord_to_fixed(float a) {
+	// Rounds to the nearest 1/16 pixel. Scaling by 16 is exact, so this gives
+	// the same result on every platform.
+	return (int32_t)floorf(a * (float)SUBPIXEL_ONE + 0.5f);
+}
+
+point_fixed_t point_to_fixed(vec2_t a) {
+	point_fixed_t p = { coord_to_fixed(a.x), coord_to_fixed(a.y) };
+	return p;
+}
+
+int64_t floor_div(int64_t a, int64_t b) {
+	// Rounds toward negative infinity. b must be positive.
+	int64_t q = a / b;
+	return (a % b < 0)? q - 1 : q;
+}
+
+int pixel_from_coord(float a) {
+	if (subpixel_raster) {
+		return (int)floor_div(coord_to_fixed(a), SUBPIXEL_ONE);
+	}
+	return (int)a;
+}
+
+void draw_line_fixed(point_fixed_t a, point_fixed_t b, color_abgr_t color) {
+	// For each column (or row, for steep lines) whose pixel center lies between the
+	// endpoints, draws the pixel that the line crosses at that center. Slow motion of
+	// an endpoint moves the line by whole pixels only where it crosses a pixel edge.
+	int64_t dx = (int64_t)b.x - a.x;
+	int64_t dy = (int64_t)b.y - a.y;
+	bool x_major = llabs(dx) >= llabs(dy);
+	
+	// Walk the major axis in increasing order
+	int64_t major0 = x_major? a.x : a.y;
+	int64_t minor0 = x_major? a.y : a.x;
+	int64_t major_len = x_major? dx : dy;
+	int64_t minor_len = x_major? dy : dx;
+	if (major_len < 0) {
+		major0 += major_len;
+		minor0 += minor_len;
+		major_len = -major_len;
+		minor_len = -minor_len;
+	}
+	if (major_len == 0) return;
+	int major_min = x_major? raster_clip.x0 : raster_clip.y0;
+	int minor_min = x_major? raster_clip.y0 : raster_clip.x0;
+	int major_max = (x_major? raster_clip.x1 : raster_clip.y1) - 1;
+	int minor_max = (x_major? raster_clip.y1 : raster_clip.x1) - 1;
+	
+	// Pixels i whose centers i * 16 + 8 are within the endpoints, clipped
+	const int64_t half = SUBPIXEL_ONE / 2;
+	int64_t i_lo = floor_div(major0 - half + SUBPIXEL_ONE - 1, SUBPIXEL_ONE);
+	int64_t i_hi = floor_div(major0 + major_len - half, SUBPIXEL_ONE);
+	if (i_lo < major_min) i_lo = major_min;
+	if (i_hi > major_max) i_hi = major_max;
+	if (i_lo > i_hi) return;
+	
+	// The minor pixel at center i is floor(n / d), where
+	// n = minor0 * major_len + (center - major0) * minor_len and d = 16 * major_len.
+	// n steps by 16 * minor_len, which is at most d, so k changes by at most 1.
+	int64_t d = SUBPIXEL_ONE * major_len;
+	int64_t n = minor0 * major_len + (i_lo * SUBPIXEL_ONE + half - major0) * minor_len;
+	int64_t k = floor_div(n, d);
+	int64_t r = n - k * d;
+	int64_t step = SUBPIXEL_ONE * minor_len;
+	
+	ptrdiff_t major_step = x_major? 1 : screen_stride;
+	ptrdiff_t minor_step = x_major? screen_stride : 1;
+	ptrdiff_t offset = (ptrdiff_t)i_lo * major_step + (ptrdiff_t)k * minor_step;
+	bool opaque = (color & 0xFF000000) == 0xFF000000;
+	
+	for (int64_t i = i_lo; i <= i_hi; i++) {
+		if (k >= minor_min && k <= minor_max) {
+			uint32_t *p = screen_pixels + offset;
+			*p = opaque? color : blend_color(*p, color);
+		}
+		offset += major_step;
+		r += step;
+		if (r >= d) {
+			r -= d;
+			k++;
+			offset += minor_step;
+		} else if (r < 0) {
+			r += d;
+			k--;
+			offset -= minor_step;
+		}
+	}
+}
+
+typedef struct {
+	int64_t a, b, c; // w(x, y) = a * x + b * y + c at the center of pixel (x, y)
+} edge_fixed_t;
+
+edge_fixed_t edge_fixed_make(point_fixed_t v0, point_fixed_t v1) {
+	// Same edge function as edge_make(), in 1/16 pixel units, and evaluated at
+	// pixel centers. The top-left rule is folded into c, so a pixel is inside
+	// if w >= 0.
+	int64_t a = (int64_t)v0.y - v1.y;
+	int64_t b = (int64_t)v1.x - v0.x;
+	int64_t c = (int64_t)v0.x * v1.y - (int64_t)v0.y * v1.x;
+	bool top_left = (a == 0 && b > 0) || a > 0;
+	const int64_t half = SUBPIXEL_ONE / 2;
+	edge_fixed_t e;
+	e.a = a * SUBPIXEL_ONE;
+	e.b = b * SUBPIXEL_ONE;
+	e.c = a * half + b * half + c - (top_left? 0 : 1);
+	return e;
+}
+
+void draw_triangle_fixed(point_fixed_t a, point_fixed_t b, point_fixed_t c, const float *depths, color_abgr_t color) {
+	// Same block walk as draw_triangle(), with exact integer edge tests.
+	// Only the depth plane is still interpolated in floating point.
+	int64_t area = ((int64_t)b.x - a.x) * ((int64_t)c.y - a.y) - ((int64_t)b.y - a.y) * ((int64_t)c.x - a.x);
+	if (area == 0) return;
+	float da = 0, db = 0, dc = 0;
+	if (depths) {
+		da = depths[0];
+		db = depths[1];
+		dc = depths[2];
+	}
+	if (area < 0) {
+		point_fixed_t t = b;
+		b = c;
+		c = t;
+		float dt = db;
+		db = dc;
+		dc = dt;
+		area = -area;
+	}
+	bool use_depth = depths && depth_format != DEPTH_NONE;
+	bool write_depth = (color & 0xFF000000) == 0xFF000000;
+	
+	// Pixels whose centers are within the bounding box, clipped to the clip rectangle
+	const int64_t half = SUBPIXEL_ONE / 2;
+	int64_t min_x = (a.x < b.x)? ((a.x < c.x)? a.x : c.x) : ((b.x < c.x)? b.x : c.x);
+	int64_t max_x = (a.x > b.x)? ((a.x > c.x)? a.x : c.x) : ((b.x > c.x)? b.x : c.x);
+	int64_t min_y = (a.y < b.y)? ((a.y < c.y)? a.y : c.y) : ((b.y < c.y)? b.y : c.y);
+	int64_t max_y = (a.y > b.y)? ((a.y > c.y)? a.y : c.y) : ((b.y > c.y)? b.y : c.y);
+	clip_rect_t clip = raster_clip;
+	int64_t x0 = floor_div(min_x - half + SUBPIXEL_ONE - 1, SUBPIXEL_ONE);
+	int64_t y0 = floor_div(min_y - half + SUBPIXEL_ONE - 1, SUBPIXEL_ONE);
+	int64_t x1 = floor_div(max_x - half, SUBPIXEL_ONE);
+	int64_t y1 = floor_div(max_y - half, SUBPIXEL_ONE);
+	if (x0 < clip.x0) x0 = clip.x0;
+	if (y0 < clip.y0) y0 = clip.y0;
+	if (x1 > clip.x1 - 1) x1 = clip.x1 - 1;
+	if (y1 > clip.y1 - 1) y1 = clip.y1 - 1;
+	if (x0 > x1 || y0 > y1) return;
+	
+	edge_fixed_t e[3] = { edge_fixed_make(b, c), edge_fixed_make(c, a), edge_fixed_make(a, b) };
+	const int bs = TRIANGLE_BLOCK_SIZE;
+	
+	// Depth plane in pixel units, from the snapped vertices
+	float d_dx = 0, d_dy = 0, d_c = 0;
+	if (use_depth) {
+		const float s = 1.0f / (float)SUBPIXEL_ONE;
+		vec2_t fa = { (float)a.x * s, (float)a.y * s };
+		vec2_t fb = { (float)b.x * s, (float)b.y * s };
+		vec2_t fc = { (float)c.x * s, (float)c.y * s };
+		edge_t ef[3] = { edge_make(fb, fc), edge_make(fc, fa), edge_make(fa, fb) };
+		float farea = (float)area * s * s;
+		d_dx = (ef[0].a * da + ef[1].a * db + ef[2].a * dc) / farea;
+		d_dy = (ef[0].b * da + ef[1].b * db + ef[2].b * dc) / farea;
+		d_c = (ef[0].c * da + ef[1].c * db + ef[2].c * dc) / farea;
+	}
+	
+	for (int by = (int)y0 - (int)y0 % bs; by <= y1; by += bs) {
+		for (int bx = (int)x0 - (int)x0 % bs; bx <= x1; bx += bs) {
+			// Pixel range of this block within the bounding box
+			int px0 = (bx > x0)? bx : (int)x0;
+			int py0 = (by > y0)? by : (int)y0;
+			int px1 = (bx + bs - 1 < x1)? bx + bs - 1 : (int)x1;
+			int py1 = (by + bs - 1 < y1)? by + bs - 1 : (int)y1;
+			
+			// Test the block corners against each edge
+			bool skip = false;
+			bool full = true;
+			for (int i = 0; i < 3; i++) {
+				int64_t w00 = e[i].a * px0 + e[i].b * py0 + e[i].c;
+				int64_t w10 = e[i].a * px1 + e[i].b * py0 + e[i].c;
+				int64_t w01 = e[i].a * px0 + e[i].b * py1 + e[i].c;
+				int64_t w11 = e[i].a * px1 + e[i].b * py1 + e[i].c;
+				if ((w00 & w10 & w01 & w11) < 0) {
+					skip = true;
+					break;
+				}
+				if ((w00 | w10 | w01 | w11) < 0) {
+					full = false;
+				}
+			}
+			if (skip) continue;
+			
+			float *block_max = NULL;
+			float block_far = 0.0f;
+			if (use_depth) {
+				float cx0 = (float)px0 + 0.5f, cx1 = (float)px1 + 0.5f;
+				float cy0 = (float)py0 + 0.5f, cy1 = (float)py1 + 0.5f;
+				block_max = &depth_block_max[(by / bs) * depth_blocks_w + (bx / bs)];
+				float d00 = d_dx * cx0 + d_dy * cy0 + d_c;
+				float d10 = d_dx * cx1 + d_dy * cy0 + d_c;
+				float d01 = d_dx * cx0 + d_dy * cy1 + d_c;
+				float d11 = d_dx * cx1 + d_dy * cy1 + d_c;
+				float block_near = fminf(fminf(d00, d10), fminf(d01, d11));
+				block_far = fmaxf(fmaxf(d00, d10), fmaxf(d01, d11));
+				if (block_near >= *block_max) continue;
+			}
+			
+			uint32_t *row = screen_pixels + (ptrdiff_t)py0 * screen_stride;
+			if (full && !use_depth) {
+				for (int y = py0; y <= py1; y++, row += screen_stride) {
+					fill_span(row, px0, px1 + 1, color);
+				}
+				continue;
+			}
+			
+			// A pixel is inside when no edge value has its sign bit set
+			bool all_passed = full;
+			for (int y = py0; y <= py1; y++, row += screen_stride) {
+				int span_start = px0;
+				int span_end = px1 + 1;
+				if (!full) {
+					int64_t w0 = e[0].a * px0 + e[0].b * y + e[0].c;
+					int64_t w1 = e[1].a * px0 + e[1].b * y + e[1].c;
+					int64_t w2 = e[2].a * px0 + e[2].b * y + e[2].c;
+					span_start = -1;
+					span_end = -1;
+					for (int x = px0; x <= px1; x++, w0 += e[0].a, w1 += e[1].a, w2 += e[2].a) {
+						if ((w0 | w1 | w2) >= 0) {
+							if (span_start < 0) span_start = x;
+							span_end = x + 1;
+						} else if (span_start >= 0) {
+							break;
+						}
+					}
+					if (span_start < 0) continue;
+				}
+				if (use_depth) {
+					float d_row = d_dy * ((float)y + 0.5f) + d_c + d_dx * 0.5f;
+					if (!depth_test_row(span_start, span_end, y, d_row, d_dx, color)) {
+						all_passed = false;
+					}
+				} else {
+					fill_span(row, span_start, span_end, color);
+				}
+			}
+			
+			if (use_depth && all_passed && write_depth && px0 == bx && py0 == by &&
+				px1 == ((bx + bs <= screen_w)? bx + bs - 1 : screen_w - 1) &&
+				py1 == ((by + bs <= screen_h)? by + bs - 1 : screen_h - 1)) {
+				*block_max = fminf(*block_max, block_far);
+			}
+		}
+	}
+}
+
+void fill_triangle_fixed(vec2_t a, vec2_t b, vec2_t c, const float *depths) {
+	// Coordinates beyond the fixed-point range are not drawn
+	if (!(fabsf(a.x) < LINE_COORD_LIMIT && fabsf(a.y) < LINE_COORD_LIMIT &&
+		  fabsf(b.x) < LINE_COORD_LIMIT && fabsf(b.y) < LINE_COORD_LIMIT &&
+		  fabsf(c.x) < LINE_COORD_LIMIT && fabsf(c.y) < LINE_COORD_LIMIT)) return;
+	point_fixed_t fa = point_to_fixed(a), fb = point_to_fixed(b), fc = point_to_fixed(c);
+	if (!tiles_enabled() || !tiles_add_triangle_fixed(fa, fb, fc, depths, fill_color)) {
+		draw_triangle_fixed(fa, fb, fc, depths, fill_color);
+	}
+}
+
+#pragma mark -
+
+void fill_triangle(vec2_t a, vec2_t b, vec2_t c) {
+	if (subpixel_raster) {
+		fill_triangle_fixed(a, b, c, NULL);
+	} else if (!tiles_enabled() || !tiles_add_triangle(a, b, c, NULL, fill_color)) {
+		draw_triangle(a, b, c, NULL, fill_color);
+	}
+}
+
+void fill_triangle_depth(vec3_t a, vec3_t b, vec3_t c) {
+	// x and y are screen coordinates and z is the depth, from 0 at the near plane
+	// to 1 at the far plane. Pixels are drawn only if they are in front of the
+	// depth buffer.
+	vec2_t a2 = { a.x, a.y };
+	vec2_t b2 = { b.x, b.y };
+	vec2_t c2 = { c.x, c.y };
+	float depths[3] = { a.z, b.z, c.z };
+	if (subpixel_raster) {
+		fill_triangle_fixed(a2, b2, c2, depths);
+	} else if (!tiles_enabled() || !tiles_add_triangle(a2, b2, c2, depths, fill_color)) {
+		draw_triangle(a2, b2, c2, depths, fill_color);
+	}
+}
+
 void set_pixel(int x, int y, color_abgr_t color) {
 	if (x < 0 || x >= screen_w) return;
 	if (y < 0 || y >= screen_h) return;
 	
 	// Apply blending if color's alpha < 255
-	int i = x + y * screen_w;
+	int i = x + y * screen_stride;
 	if ((color & 0xFF000000) != 0xFF000000) {
 		color = blend_color(screen_pixels[i], color);
 	}
@@ -200,8 +1161,147 @@ vec2_t perspective_project_point(vec3_t pt3d) {
 	return pt2d;
 }
 
+vec3_t perspective_project_point_depth(vec3_t pt3d) {
+	// Like perspective_project_point(), with the depth buffer value in z
+	pt3d = vec3_mat4_mul(pt3d, camera_transform_3d);
+	
+	vec2_t pt2d = { .x = pt3d.x / pt3d.z, .y = pt3d.y / pt3d.z };
+	pt2d = vec2_mat3_mul(pt2d, view_transform_2d);
+	
+	vec3_t result = { pt2d.x, pt2d.y, depth_from_view_z(pt3d.z) };
+	return result;
+}
+
+void perspective_project_points(const float *x, const float *y, const float *z, float *screen_x, float *screen_y, float *depth, int count) {
+	// Batch version of perspective_project_point_depth() for points in
+	// structure-of-arrays layout. The outputs hold the camera space points
+	// until they are projected in place.
+	mat4_transform_points(&camera_transform_3d, x, y, z, screen_x, screen_y, depth, count);
+	mat3_project_points(&view_transform_2d, screen_x, screen_y, depth, screen_x, screen_y, count);
+	for (int i = 0; i < count; i++) {
+		depth[i] = depth_from_view_z(depth[i]);
+	}
+}
+
+float depth_from_view_z(float z) {
+	// Maps the near plane to 0 and the far plane to 1. The result is linear in 1/z,
+	// so it can be interpolated linearly in screen space.
+	return (Z_FAR / (Z_FAR - Z_NEAR)) * (1.0f - Z_NEAR / z);
+}
+
 vec3_t get_camera_position(void) {
 	vec3_t a = { 0, 0, 0 };
 	vec3_t b = vec3_mat4_mul(a, camera_transform_3d);
 	return vec3_sub(a, b);
 }
+
+#pragma mark - Clip Space
+
+mat4_t get_model_view_projection(mat4_t model) {
+	mat4_t m = mat4_mul(viewport_matrix, perspective_matrix);
+	m = mat4_mul(m, camera_transform_3d);
+	return mat4_mul(m, model);
+}
+
+float clip_plane_distance(int plane, vec4_t p) {
+	// Positive inside the plane. Plane i is outcode bit i. The side planes are
+	// the edges of the guard band, in screen coordinates times w.
+	switch (plane) {
+	case 0: return p.z; // Near
+	case 1: return p.w - p.z; // Far
+	case 2: return p.x + GUARD_BAND * p.w; // Left
+	case 3: return ((float)screen_w + GUARD_BAND) * p.w - p.x; // Right
+	case 4: return p.y + GUARD_BAND * p.w; // Top
+	default: return ((float)screen_h + GUARD_BAND) * p.w - p.y; // Bottom
+	}
+}
+
+uint8_t clip_outcode(vec4_t p) {
+	uint8_t code = 0;
+	for (int i = 0; i < CLIP_PLANE_COUNT; i++) {
+		if (clip_plane_distance(i, p) < 0.0f) code |= (uint8_t)(1 << i);
+	}
+	return code;
+}
+
+void clip_transform_points(const mat4_t *mvp, const float *x, const float *y, const float *z, clip_vertices_t *out, int count) {
+	// Transforms to clip space in a batch, then divides the vertices that
+	// are inside every clip plane.
+	mat4_transform_points_homogeneous(mvp, x, y, z, out->x, out->y, out->z, out->w, count);
+	for (int i = 0; i < count; i++) {
+		vec4_t p = { out->x[i], out->y[i], out->z[i], out->w[i] };
+		out->outcode[i] = clip_outcode(p);
+		out->screen_x[i] = p.x / p.w;
+		out->screen_y[i] = p.y / p.w;
+		out->depth[i] = p.z / p.w;
+	}
+}
+
+int clip_polygon(clip_vertex_t *v, int count, uint8_t planes) {
+	// Sutherland-Hodgman clipping of a convex polygon against each plane in
+	// planes. v must have room for CLIP_MAX_VERTICES.
+	clip_vertex_t temp[CLIP_MAX_VERTICES];
+	for (int plane = 0; plane < CLIP_PLANE_COUNT && count > 0; plane++) {
+		if ((planes & (1 << plane)) == 0) continue;
+		
+		int n = 0;
+		for (int i = 0; i < count; i++) {
+			clip_vertex_t a = v[i];
+			clip_vertex_t b = v[(i + 1) % count];
+			float da = clip_plane_distance(plane, a.p);
+			float db = clip_plane_distance(plane, b.p);
+			if (da >= 0.0f) {
+				temp[n++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				// The edge crosses the plane. Leaving the plane, the next edge runs
+				// along it and is not drawn. Entering, it continues edge a-b.
+				float t = da / (da - db);
+				clip_vertex_t c;
+				c.p.x = a.p.x + (b.p.x - a.p.x) * t;
+				c.p.y = a.p.y + (b.p.y - a.p.y) * t;
+				c.p.z = a.p.z + (b.p.z - a.p.z) * t;
+				c.p.w = a.p.w + (b.p.w - a.p.w) * t;
+				c.edge = (da < 0.0f) && a.edge;
+				c.original = false;
+				temp[n++] = c;
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			v[i] = temp[i];
+		}
+		count = n;
+	}
+	return count;
+}
+
+bool clip_segment(vec4_t *a, vec4_t *b, uint8_t planes) {
+	// Clips the line segment a-b against each plane in planes, like
+	// clip_polygon() does for each edge. Returns false if none of it is left.
+	for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++) {
+		if ((planes & (1 << plane)) == 0) continue;
+		
+		float da = clip_plane_distance(plane, *a);
+		float db = clip_plane_distance(plane, *b);
+		if (da < 0.0f && db < 0.0f) return false;
+		if ((da >= 0.0f) == (db >= 0.0f)) continue;
+		
+		float t = da / (da - db);
+		vec4_t c;
+		c.x = a->x + (b->x - a->x) * t;
+		c.y = a->y + (b->y - a->y) * t;
+		c.z = a->z + (b->z - a->z) * t;
+		c.w = a->w + (b->w - a->w) * t;
+		if (da < 0.0f) {
+			*a = c;
+		} else {
+			*b = c;
+		}
+	}
+	return true;
+}
+
+vec3_t clip_to_screen(vec4_t p) {
+	vec3_t r = { p.x / p.w, p.y / p.w, p.z / p.w };
+	return r;
+}
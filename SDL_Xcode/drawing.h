@@ -13,6 +13,44 @@
 #include "vector.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Depth buffer formats
+typedef enum {
+	DEPTH_NONE,
+	DEPTH_16, // 16-bit unsigned normalized
+	DEPTH_32F // 32-bit float
+} depth_format_t;
+
+// Clip rectangle: x1 and y1 are exclusive
+typedef struct {
+	int x0, y0, x1, y1;
+} clip_rect_t;
+
+// Vertices in clip space, in structure-of-arrays layout
+typedef struct {
+	float *x, *y, *z, *w; // Clip coordinates
+	float *screen_x, *screen_y, *depth; // Divided by w, only valid where the outcode is 0
+	uint8_t *outcode; // Bit set for each clip plane the vertex is outside of
+} clip_vertices_t;
+
+// A vertex of a polygon being clipped
+typedef struct {
+	vec4_t p;
+	bool edge; // The edge to the next vertex is part of an edge of the original triangle
+	bool original; // Not made by clipping
+} clip_vertex_t;
+
+// A triangle clipped by all six planes has at most this many vertices
+#define CLIP_MAX_VERTICES (9)
+
+// Screen point in 28.4 fixed point: 1/16 pixel units
+typedef struct {
+	int32_t x, y;
+} point_fixed_t;
+
+#define SUBPIXEL_BITS (4)
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
 
 // Drawing context
 extern color_abgr_t line_color;
@@ -24,10 +62,28 @@ extern mat3_t view_transform_2d;
 extern mat4_t camera_transform_3d;
 
 // SDL Interface
+// In HEADLESS builds these fall back to the offscreen interface below.
 bool init_screen(int width, int height, int scale);
 void destroy_screen(void);
+bool enable_zero_copy(bool enable); // Draws into the texture. Blended pixels are read back from it, which can be slow.
+void begin_frame(void);
 void render_to_screen(void);
 
+// Offscreen Interface
+bool init_offscreen(int width, int height);
+void destroy_offscreen(void);
+void set_frame_dump_path(const char *path_format);
+bool save_screen_to_file(const char *path);
+
+// Depth Buffer
+bool init_depth_buffer(depth_format_t format);
+void destroy_depth_buffer(void);
+void clear_depth_buffer(void);
+
+// Clipping
+clip_rect_t screen_rect(void);
+void set_clip_rect(clip_rect_t r);
+
 // Drawing 2D
 void fill_screen(color_abgr_t color);
 
@@ -35,13 +91,49 @@ void move_to(vec2_t a);
 void line_to(vec2_t a);
 void fill_rect(int x, int y, int w, int h);
 void fill_centered_rect(int x, int y, int w, int h);
+void fill_triangle(vec2_t a, vec2_t b, vec2_t c);
+void fill_triangle_depth(vec3_t a, vec3_t b, vec3_t c);
+
+// Rasterizer: draws right away with an explicit color, clipped to the
+// calling thread's clip rectangle. The drawing functions above go through
+// the tiled renderer instead when it is enabled.
+void draw_line(int x0, int y0, int x1, int y1, color_abgr_t color);
+void draw_rect(int x, int y, int w, int h, color_abgr_t color);
+void draw_triangle(vec2_t a, vec2_t b, vec2_t c, const float *depths, color_abgr_t color);
+void clear_rect(clip_rect_t r, color_abgr_t color);
+void clear_depth_rect(clip_rect_t r);
 
 void set_pixel(int x, int y, color_abgr_t color);
 
+// Subpixel Raster
+// While enabled, line_to(), fill_triangle() and fill_triangle_depth() snap
+// their coordinates to 1/16 pixel and rasterize with integer edge tests.
+// Edges shared by two triangles are then exact, and every build draws the
+// same pixels. Coordinates must be within 1048576 pixels of the origin.
+void enable_subpixel_raster(bool enable);
+bool subpixel_raster_enabled(void);
+point_fixed_t point_to_fixed(vec2_t a);
+int pixel_from_coord(float a); // The pixel containing a, after snapping if enabled
+void draw_line_fixed(point_fixed_t a, point_fixed_t b, color_abgr_t color);
+void draw_triangle_fixed(point_fixed_t a, point_fixed_t b, point_fixed_t c, const float *depths, color_abgr_t color);
+
 // Projection 3D
 void init_projection(void);
 vec2_t orthographic_project_point(vec3_t pt3d);
 vec2_t perspective_project_point(vec3_t pt3d);
+vec3_t perspective_project_point_depth(vec3_t pt3d);
+void perspective_project_points(const float *x, const float *y, const float *z, float *screen_x, float *screen_y, float *depth, int count);
+float depth_from_view_z(float z);
 vec3_t get_camera_position(void);
 
+// Clip Space
+// The model-view-projection matrix takes model space straight to clip space.
+// Dividing clip space x, y and z by w gives screen x, y and depth.
+mat4_t get_model_view_projection(mat4_t model);
+void clip_transform_points(const mat4_t *mvp, const float *x, const float *y, const float *z, clip_vertices_t *out, int count);
+uint8_t clip_outcode(vec4_t p);
+int clip_polygon(clip_vertex_t *v, int count, uint8_t planes); // Clips in place and returns the new count
+bool clip_segment(vec4_t *a, vec4_t *b, uint8_t planes); // Clips in place, false if nothing is left
+vec3_t clip_to_screen(vec4_t p);
+
 #endif /* drawing_h */
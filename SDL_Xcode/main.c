@@ -3,14 +3,23 @@
 #include "color.h"
 #include "drawing.h"
 #include "mesh.h"
+#include "mesh_io.h"
+#include "profiler.h"
+#include "scene.h"
+#include "tiles.h"
 #include "vector.h"
 #include "matrix.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
+#ifndef HEADLESS
 #include <SDL2/SDL.h>
+#endif
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
@@ -22,11 +31,15 @@
 
 // Globals
 bool is_running = true;
+bool fill_faces = false;
+const char *profile_csv_path = NULL;
 uint64_t last_update_time = 0;
 mesh_t *cube = NULL;
+scene_t *scene = NULL; // Instances of the cube, if any
 
 #pragma mark - Game Loop
 
+#ifndef HEADLESS
 void process_keyboard_input(void) {
 	SDL_Event event;
 	SDL_PollEvent(&event);
@@ -47,7 +60,7 @@ void process_keyboard_input(void) {
 			case SDLK_0:
 				// Reset both angular momentum and rotation
 				cube->angular_momentum = vec3_zero();
-				cube->rotation = mat4_identity();
+				cube->orientation = quat_identity();
 				break;
 			case SDLK_e:
 				// Roll right
@@ -77,41 +90,121 @@ void process_keyboard_input(void) {
 				// Stop movement
 				cube->angular_momentum = vec3_zero();
 				break;
+			case SDLK_f:
+				// Toggle filled faces. Only they are depth tested, so the depth
+				// buffer is kept only while they are on.
+				fill_faces = !fill_faces;
+				if (!init_depth_buffer(fill_faces? DEPTH_32F : DEPTH_NONE)) {
+					fill_faces = false;
+				}
+				break;
+			case SDLK_h:
+				// Toggle the diagonals inside flat quads
+				cube->hide_coplanar_edges = !cube->hide_coplanar_edges;
+				break;
+			case SDLK_x:
+				// Toggle subpixel raster
+				enable_subpixel_raster(!subpixel_raster_enabled());
+				break;
+			case SDLK_p:
+				// Print frame timing
+				profile_print_report(stdout);
+				break;
 		}
 		break;
 	}
 }
+#endif
 
 void update_state(uint64_t delta_time) {
 	double delta_seconds = (double)delta_time / 1000.0;
 
-	mesh_update(cube, delta_seconds);
+	if (scene) {
+		// The instances share the cube's colors, which follow its lifetime
+		scene_update(scene, delta_seconds);
+		cube->lifetime += delta_seconds;
+	} else {
+		mesh_update(cube, delta_seconds);
+	}
 	
 	// Update cube colors
 	double hue = fmod(cube->lifetime * 7.5, 360);
 	cube->line_color = color_from_hsv(hue, 1.0, 1.0, 1.0);
 	cube->point_color = color_from_hsv(fmod(hue + 60, 360), 1.0, 1.0, 0.5);
+	cube->fill_color = fill_faces? color_from_hsv(fmod(hue + 180, 360), 0.5, 0.5, 1.0) : 0;
 }
 
 void run_render_pipeline(void) {
+	begin_frame();
+	uint64_t start_time = profile_now();
 	fill_screen(ABGR_BLACK);
-	mesh_draw(cube);
+	clear_depth_buffer();
+	profile_add(PROFILE_CLEAR, start_time);
+	
+	start_time = profile_now();
+	if (scene) {
+		scene_draw(scene);
+	} else {
+		mesh_draw(cube);
+	}
+	profile_add(PROFILE_DRAW, start_time);
+	
 	render_to_screen();
 }
 
+void report_profile(void) {
+	// Called at exit
+	profile_print_report(stdout);
+	if (profile_csv_path) {
+		profile_write_csv(profile_csv_path);
+	}
+}
+
 #pragma mark - Init & Clean Up
 
+mesh_t *load_mesh(const char *path) {
+	// The cube by default, or a mesh file scaled to fit where the cube would be
+	if (!path) return mesh_new_cube();
+	mesh_t *mesh = mesh_load(path);
+	if (mesh) {
+		// Mapped meshes are drawn as they are, so their pages stay shared with
+		// the file. meshconv fits them to the cube in advance.
+		if (!mesh->mapping) mesh_normalize(mesh);
+		fprintf(stdout, "Loaded %s: %d vertices, %d triangles.\n", path, mesh->vertex_count, mesh->face_count);
+	}
+	return mesh;
+}
+
+bool init_scene(int count) {
+	// Replaces the single mesh with count spinning copies of it
+	if (count <= 0) return true;
+	scene = scene_new_grid(cube, count);
+	if (!scene) return false;
+	fprintf(stdout, "Scene of %d instances.\n", count);
+	return true;
+}
+
+#ifndef HEADLESS
+
 void run_game_loop(void) {
 	// Run one iteration of game loop
 	uint64_t update_start_time = SDL_GetTicks64();
 	uint64_t delta_time = update_start_time - last_update_time;
 	
+	profile_begin_frame();
+	uint64_t start_time = profile_now();
 	process_keyboard_input();
+	profile_add(PROFILE_INPUT, start_time);
 	if (!is_running) return;
+	
+	start_time = profile_now();
 	if (delta_time > 0) {
 		update_state(delta_time);
 	}
+	profile_add(PROFILE_UPDATE, start_time);
+	
 	run_render_pipeline();
+	profile_end_frame();
 	
 #ifndef __EMSCRIPTEN__
 	// Xcode version: delay to cap FPS
@@ -128,10 +221,44 @@ void run_game_loop(void) {
 }
 
 int main(int argc, const char * argv[]) {
+	// Options: -profile PATH writes frame timing as CSV at exit,
+	// -mesh PATH shows an OBJ or PLY file instead of the cube,
+	// -cubes N shows N spinning copies,
+	// -threads N draws in tiles on N threads, 0 for one per core,
+	// -zero-copy 1 draws straight into the streaming texture,
+	// -subpixel 1 rasterizes in 28.4 fixed point
+	const char *mesh_path = NULL;
+	int instance_count = 0;
+	int threads = -1;
+	bool use_zero_copy = false;
+	bool use_subpixel = false;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "-profile") == 0) {
+			profile_csv_path = argv[i + 1];
+		} else if (strcmp(argv[i], "-mesh") == 0) {
+			mesh_path = argv[i + 1];
+		} else if (strcmp(argv[i], "-cubes") == 0) {
+			instance_count = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "-threads") == 0) {
+			threads = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "-zero-copy") == 0) {
+			use_zero_copy = atoi(argv[i + 1]) != 0;
+		} else if (strcmp(argv[i], "-subpixel") == 0) {
+			use_subpixel = atoi(argv[i + 1]) != 0;
+		}
+	}
+	
 	if (!init_screen(1280, 720, 1)) return 0;
+	if (threads >= 0 && !init_tiles(threads)) return 0;
+	// Off by default: blending reads pixels back, and locked texture memory
+	// may be uncached or slow to read
+	if (use_zero_copy) enable_zero_copy(true);
+	if (use_subpixel) enable_subpixel_raster(true);
 	
 	init_projection();
-	cube = mesh_new_cube();
+	cube = load_mesh(mesh_path);
+	if (!cube) return 0;
+	if (!init_scene(instance_count)) return 0;
 	
 	last_update_time = SDL_GetTicks64();
 	
@@ -143,8 +270,112 @@ int main(int argc, const char * argv[]) {
 	while (is_running) {
 		run_game_loop();
 	}
+	report_profile();
 	destroy_screen();
 #endif
 
 	return 0;
 }
+
+#else
+
+double get_time_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1.0e9;
+}
+
+int main(int argc, const char * argv[]) {
+	// Headless version: render a fixed number of frames at a fixed time step,
+	// with no window or SDL video. Options:
+	//   -frames N         number of frames to render (default 300)
+	//   -size WxH         frame buffer size (default 1280x720)
+	//   -dump PATTERN     write each frame to a PPM file, e.g. "frame_%04d.ppm"
+	//   -fill             draw filled faces
+	//   -depth 0|16|32    depth buffer bits for -fill, 0 for none (default 32)
+	//   -threads N        draw in tiles on N threads, 0 for one per core (default off)
+	//   -subpixel         rasterize in 28.4 fixed point
+	//   -profile PATH     write per-stage frame timing to a CSV file
+	//   -mesh PATH        draw an OBJ or PLY file instead of the cube
+	//   -hide-coplanar    leave out the diagonals inside flat quads
+	//   -cubes N          draw N spinning copies of the mesh in a grid
+	int frame_count = 300;
+	int width = 1280;
+	int height = 720;
+	const char *dump_path = NULL;
+	depth_format_t depth = DEPTH_32F;
+	int threads = -1;
+	const char *mesh_path = NULL;
+	bool hide_coplanar = false;
+	int instance_count = 0;
+	
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+			frame_count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				fprintf(stderr, "Invalid size: %s\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-dump") == 0 && i + 1 < argc) {
+			dump_path = argv[++i];
+		} else if (strcmp(argv[i], "-fill") == 0) {
+			fill_faces = true;
+		} else if (strcmp(argv[i], "-depth") == 0 && i + 1 < argc) {
+			int bits = atoi(argv[++i]);
+			depth = (bits == 16)? DEPTH_16 : (bits == 32)? DEPTH_32F : DEPTH_NONE;
+		} else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-subpixel") == 0) {
+			enable_subpixel_raster(true);
+		} else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+			profile_csv_path = argv[++i];
+		} else if (strcmp(argv[i], "-mesh") == 0 && i + 1 < argc) {
+			mesh_path = argv[++i];
+		} else if (strcmp(argv[i], "-hide-coplanar") == 0) {
+			hide_coplanar = true;
+		} else if (strcmp(argv[i], "-cubes") == 0 && i + 1 < argc) {
+			instance_count = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [-frames N] [-size WxH] [-dump PATTERN] [-fill] [-depth 0|16|32] [-threads N] [-subpixel] [-profile PATH] [-mesh PATH] [-hide-coplanar] [-cubes N]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	if (!init_screen(width, height, 1)) return 1;
+	// Only filled faces are depth tested
+	if (fill_faces && !init_depth_buffer(depth)) return 1;
+	if (threads >= 0 && !init_tiles(threads)) return 1;
+	set_frame_dump_path(dump_path);
+	cube = load_mesh(mesh_path);
+	if (!cube) return 1;
+	cube->hide_coplanar_edges = hide_coplanar;
+	if (!init_scene(instance_count)) return 1;
+	// Spin the cube so that frames cover a range of orientations
+	cube->angular_momentum = vec3_make(20, 30, 10);
+	
+	double start_time = get_time_seconds();
+	for (int i = 0; i < frame_count; i++) {
+		profile_begin_frame();
+		uint64_t update_time = profile_now();
+		update_state(FRAME_TARGET_TIME);
+		profile_add(PROFILE_UPDATE, update_time);
+		run_render_pipeline();
+		profile_end_frame();
+	}
+	double elapsed = get_time_seconds() - start_time;
+	
+	double frames = (frame_count > 0)? (double)frame_count : 1.0;
+	if (tiles_enabled()) {
+		fprintf(stdout, "Tiled rendering on %d threads.\n", tiles_thread_count());
+	}
+	fprintf(stdout, "Rendered %d frames (%dx%d) in %.3fs: %.3fms/frame, %.1f fps, %.1f Mpixel/s.\n",
+			frame_count, width, height, elapsed, elapsed * 1000.0 / frames,
+			frames / elapsed, frames * width * height / elapsed / 1.0e6);
+	report_profile();
+	
+	destroy_screen();
+	return 0;
+}
+
+#endif
@@ -6,18 +6,41 @@
 //
 
 #include "matrix.h"
+#include "trig.h"
 #include <math.h>
+#include <string.h>
 
-#pragma mark - 2D Matrix
+#ifndef VECMATH_INLINE
+#include "matrix_impl.h"
+#endif
 
-mat3_t mat3_identity(void) {
-	mat3_t m = {
-		1, 0, 0,
-		0, 1, 0,
-		0, 0, 1
-	};
-	return m;
-}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATRIX_NEON_KERNELS 1
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define MATRIX_WASM 1
+#endif
+
+typedef void (*mat4_mul_func_t)(mat4_t *c, const mat4_t *a, const mat4_t *b);
+typedef vec4_t (*vec4_mat4_mul_func_t)(vec4_t v, const mat4_t *m);
+typedef void (*mat3_mul_func_t)(mat3_t *c, const mat3_t *a, const mat3_t *b);
+typedef void (*mat4_transform_points_func_t)(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count);
+typedef void (*mat4_transform_points_homogeneous_func_t)(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count);
+typedef void (*mat3_project_points_func_t)(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count);
+
+mat4_mul_func_t mat4_mul_func = NULL;
+vec4_mat4_mul_func_t vec4_mat4_mul_func = NULL;
+mat3_mul_func_t mat3_mul_func = NULL;
+mat4_transform_points_func_t mat4_transform_points_func = NULL;
+mat4_transform_points_homogeneous_func_t mat4_transform_points_homogeneous_func = NULL;
+mat3_project_points_func_t mat3_project_points_func = NULL;
+matrix_kernel_t matrix_kernel = MATRIX_AUTO;
+
+#pragma mark - 2D Matrix
 
 mat3_t mat3_translate(mat3_t m, vec2_t t) {
 	mat3_t n = {
@@ -38,69 +61,51 @@ mat3_t mat3_scale(mat3_t m, vec2_t s) {
 }
 
 mat3_t mat3_rotate(mat3_t m, float a) {
+	float s, c;
+	trig_sincos(a, &s, &c);
 	mat3_t n = {
-		cosf(a), -sinf(a), 0,
-		sinf(a), cosf(a), 0,
+		c, -s, 0,
+		s, c, 0,
 		0, 0, 1
 	};
 	return mat3_mul(m, n);
 }
 
 mat3_t mat3_mul(const mat3_t a, const mat3_t b) {
-	mat3_t c = {0};
-
-	for (int i = 0; i < 3; i++) {
-		for (int j = 0; j < 3; j++) {
-			c.m[i][j] = 0;
-			for (int k = 0; k < 3; k++) {
-				c.m[i][j] += a.m[i][k] * b.m[k][j];
-			}
-		}
-	}
+	// The kernel is chosen on first use
+	if (!mat3_mul_func) matrix_use_kernel(MATRIX_AUTO);
+	mat3_t c;
+	mat3_mul_func(&c, &a, &b);
 	return c;
 }
 
-vec2_t vec2_mat3_mul(const vec2_t v, const mat3_t m) {
-	vec2_t b;
-	b.x = m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2];
-	b.y = m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2];
-	//float w = m[2][0] * a.x + m[2][1] * a.y + m[2][2];
-	return b;
-}
-
-vec3_t vec3_mat3_mul(const vec3_t a, const mat3_t m) {
-	vec3_t b;
-	b.x = m.m[0][0] * a.x + m.m[0][1] * a.y + m.m[0][2] * a.z;
-	b.y = m.m[1][0] * a.x + m.m[1][1] * a.y + m.m[1][2] * a.z;
-	b.z = m.m[2][0] * a.x + m.m[2][1] * a.y + m.m[2][2] * a.z;
-	return b;
-}
-
 #pragma mark - 3D Matrix
 
-
-mat4_t mat4_identity(void) {
-	mat4_t m = {
-		1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1
-	};
-	return m;
-}
-
 mat4_t mat4_perspective_matrix(float fov, float aspect, float znear, float zfar) {
+	// Maps view space to clip space, where x, y and z are between -w and w,
+	// and z is 0 at the near plane and w at the far plane. w is the view z.
 	mat4_t m = { 0 };
 	float scale = 1.0f / tanf(fov / 2.0f);
 	m.m[0][0] = aspect * scale;
 	m.m[1][1] = scale;
 	m.m[2][2] = zfar / (zfar - znear);
-	m.m[2][3] = (zfar * znear) / (zfar - znear);
+	m.m[2][3] = -(zfar * znear) / (zfar - znear);
 	m.m[3][2] = 1;
 	
 	return m;
 }
 
+mat4_t mat4_viewport_matrix(float width, float height) {
+	// Maps x and y from -1...1 to 0...width and 0...height, leaving z and w alone
+	mat4_t m = {
+		width / 2.0f, 0, 0, width / 2.0f,
+		0, height / 2.0f, 0, height / 2.0f,
+		0, 0, 1, 0,
+		0, 0, 0, 1
+	};
+	return m;
+}
+
 mat4_t mat4_translate(mat4_t m, vec3_t t) {
 	mat4_t n = {
 		1, 0, 0, t.x,
@@ -122,29 +127,35 @@ mat4_t mat4_scale(mat4_t m, vec3_t s) {
 }
 
 mat4_t mat4_rot_x(mat4_t m, float a) {
+	float s, c;
+	trig_sincos(a, &s, &c);
 	mat4_t n = {
 		1, 0, 0, 0,
-		0, cosf(a), -sinf(a), 0,
-		0, sinf(a), cosf(a), 0,
+		0, c, -s, 0,
+		0, s, c, 0,
 		0, 0, 0, 1
 	};
 	return mat4_mul(m, n);
 }
 
 mat4_t mat4_rot_y(mat4_t m, float a) {
+	float s, c;
+	trig_sincos(a, &s, &c);
 	mat4_t n = {
-		 cosf(a), 0, sinf(a), 0,
+		 c, 0, s, 0,
 		 0, 1, 0, 0,
-		 -sinf(a), 0, cosf(a), 0,
+		 -s, 0, c, 0,
 		 0, 0, 0, 1
 	 };
 	return mat4_mul(m, n);
 }
 
 mat4_t mat4_rot_z(mat4_t m, float a) {
+	float s, c;
+	trig_sincos(a, &s, &c);
 	mat4_t n = {
-		cosf(a), -sinf(a), 0, 0,
-		sinf(a), cosf(a), 0, 0,
+		c, -s, 0, 0,
+		s, c, 0, 0,
 		0, 0, 1, 0,
 		0, 0, 0, 1
 	};
@@ -159,33 +170,560 @@ mat4_t mat4_apply_euler_angles(mat4_t m, vec3_t a) {
 }
 
 mat4_t mat4_mul(const mat4_t a, const mat4_t b) {
-	mat4_t c  = {0};
+	if (!mat4_mul_func) matrix_use_kernel(MATRIX_AUTO);
+	mat4_t c;
+	mat4_mul_func(&c, &a, &b);
+	return c;
+}
 
+vec4_t vec4_mat4_mul(const vec4_t v, const mat4_t m) {
+	if (!vec4_mat4_mul_func) matrix_use_kernel(MATRIX_AUTO);
+	return vec4_mat4_mul_func(v, &m);
+}
+
+#pragma mark - Batch
+
+void mat4_transform_points(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	if (!mat4_transform_points_func) matrix_use_kernel(MATRIX_AUTO);
+	mat4_transform_points_func(m, x, y, z, out_x, out_y, out_z, count);
+}
+
+void mat4_transform_points_homogeneous(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	if (!mat4_transform_points_homogeneous_func) matrix_use_kernel(MATRIX_AUTO);
+	mat4_transform_points_homogeneous_func(m, x, y, z, out_x, out_y, out_z, out_w, count);
+}
+
+void mat3_project_points(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	if (!mat3_project_points_func) matrix_use_kernel(MATRIX_AUTO);
+	mat3_project_points_func(m, x, y, z, out_x, out_y, count);
+}
+
+#pragma mark - Kernels
+
+void mat4_mul_scalar(mat4_t *c, const mat4_t *a, const mat4_t *b) {
+	// Sums into a local so the stores to c cannot alias a or b
+	mat4_t r;
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 4; j++) {
-			c.m[i][j] = 0;
+			r.m[i][j] = 0;
 			for (int k = 0; k < 4; k++) {
-				c.m[i][j] += a.m[i][k] * b.m[k][j];
+				r.m[i][j] += a->m[i][k] * b->m[k][j];
 			}
 		}
 	}
+	*c = r;
+}
+
+vec4_t vec4_mat4_mul_scalar(vec4_t v, const mat4_t *m) {
+	vec4_t c;
+	c.x = m->m[0][0] * v.x + m->m[0][1] * v.y + m->m[0][2] * v.z + m->m[0][3] * v.w;
+	c.y = m->m[1][0] * v.x + m->m[1][1] * v.y + m->m[1][2] * v.z + m->m[1][3] * v.w;
+	c.z = m->m[2][0] * v.x + m->m[2][1] * v.y + m->m[2][2] * v.z + m->m[2][3] * v.w;
+	c.w = m->m[3][0] * v.x + m->m[3][1] * v.y + m->m[3][2] * v.z + m->m[3][3] * v.w;
 	return c;
 }
 
-vec3_t vec3_mat4_mul(const vec3_t v, const mat4_t m) {
-	vec4_t a = vec3_to_vec4(v);
-	vec4_t b = vec4_mat4_mul(a, m);
-	return vec4_to_vec3(b);
+void mat3_mul_scalar(mat3_t *c, const mat3_t *a, const mat3_t *b) {
+	mat3_t r;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			r.m[i][j] = 0;
+			for (int k = 0; k < 3; k++) {
+				r.m[i][j] += a->m[i][k] * b->m[k][j];
+			}
+		}
+	}
+	*c = r;
 }
 
-vec4_t vec4_mat4_mul(const vec4_t v, const mat4_t m) {
-	float b[4] = { v.x, v.y, v.z, v.w };
-	float c[4] = { 0, 0, 0, 0 };
+void mat4_transform_points_scalar(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	// Same order of operations as vec4_mat4_mul() with w = 1, so the results match
+	for (int i = 0; i < count; i++) {
+		float px = x[i], py = y[i], pz = z[i];
+		out_x[i] = m->m[0][0] * px + m->m[0][1] * py + m->m[0][2] * pz + m->m[0][3];
+		out_y[i] = m->m[1][0] * px + m->m[1][1] * py + m->m[1][2] * pz + m->m[1][3];
+		out_z[i] = m->m[2][0] * px + m->m[2][1] * py + m->m[2][2] * pz + m->m[2][3];
+	}
+}
+
+void mat4_transform_points_homogeneous_scalar(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	for (int i = 0; i < count; i++) {
+		float px = x[i], py = y[i], pz = z[i];
+		out_x[i] = m->m[0][0] * px + m->m[0][1] * py + m->m[0][2] * pz + m->m[0][3];
+		out_y[i] = m->m[1][0] * px + m->m[1][1] * py + m->m[1][2] * pz + m->m[1][3];
+		out_z[i] = m->m[2][0] * px + m->m[2][1] * py + m->m[2][2] * pz + m->m[2][3];
+		out_w[i] = m->m[3][0] * px + m->m[3][1] * py + m->m[3][2] * pz + m->m[3][3];
+	}
+}
+
+void mat3_project_points_scalar(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	for (int i = 0; i < count; i++) {
+		float px = x[i] / z[i], py = y[i] / z[i];
+		out_x[i] = m->m[0][0] * px + m->m[0][1] * py + m->m[0][2];
+		out_y[i] = m->m[1][0] * px + m->m[1][1] * py + m->m[1][2];
+	}
+}
+
+#ifdef MATRIX_X86
+
+void mat4_mul_sse(mat4_t *c, const mat4_t *a, const mat4_t *b) {
+	// Row i of c is the sum of the rows of b, weighted by row i of a
+	__m128 b0 = _mm_load_ps(b->m[0]);
+	__m128 b1 = _mm_load_ps(b->m[1]);
+	__m128 b2 = _mm_load_ps(b->m[2]);
+	__m128 b3 = _mm_load_ps(b->m[3]);
 	for (int i = 0; i < 4; i++) {
-		for (int j = 0; j < 4; j++) {
-			c[i] += m.m[i][j] * b[j];
-		}
+		__m128 r = _mm_mul_ps(_mm_set1_ps(a->m[i][0]), b0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a->m[i][1]), b1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a->m[i][2]), b2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a->m[i][3]), b3));
+		_mm_store_ps(c->m[i], r);
+	}
+}
+
+__attribute__((target("avx")))
+void mat4_mul_avx(mat4_t *c, const mat4_t *a, const mat4_t *b) {
+	// Two rows of c at a time: each 128-bit lane holds one row
+	__m256 b0 = _mm256_broadcast_ps((const __m128 *)b->m[0]);
+	__m256 b1 = _mm256_broadcast_ps((const __m128 *)b->m[1]);
+	__m256 b2 = _mm256_broadcast_ps((const __m128 *)b->m[2]);
+	__m256 b3 = _mm256_broadcast_ps((const __m128 *)b->m[3]);
+	for (int i = 0; i < 4; i += 2) {
+		__m256 ar = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(a->m[i])), _mm_load_ps(a->m[i + 1]), 1);
+		__m256 r = _mm256_mul_ps(_mm256_permute_ps(ar, 0x00), b0);
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(ar, 0x55), b1));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(ar, 0xAA), b2));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(ar, 0xFF), b3));
+		_mm256_storeu_ps(c->m[i], r);
+	}
+}
+
+vec4_t vec4_mat4_mul_sse(vec4_t v, const mat4_t *m) {
+	// Multiply each row by v, then add up the four products of each row
+	__m128 vv = _mm_loadu_ps(&v.x);
+	__m128 r0 = _mm_mul_ps(_mm_load_ps(m->m[0]), vv);
+	__m128 r1 = _mm_mul_ps(_mm_load_ps(m->m[1]), vv);
+	__m128 r2 = _mm_mul_ps(_mm_load_ps(m->m[2]), vv);
+	__m128 r3 = _mm_mul_ps(_mm_load_ps(m->m[3]), vv);
+	__m128 s01 = _mm_add_ps(_mm_unpacklo_ps(r0, r1), _mm_unpackhi_ps(r0, r1));
+	__m128 s23 = _mm_add_ps(_mm_unpacklo_ps(r2, r3), _mm_unpackhi_ps(r2, r3));
+	__m128 sum = _mm_add_ps(_mm_movelh_ps(s01, s23), _mm_movehl_ps(s23, s01));
+	vec4_t c;
+	_mm_storeu_ps(&c.x, sum);
+	return c;
+}
+
+void mat3_mul_sse(mat3_t *c, const mat3_t *a, const mat3_t *b) {
+	// Same as the mat4 kernel, with the last lane unused
+	__m128 b0 = _mm_setr_ps(b->m[0][0], b->m[0][1], b->m[0][2], 0.0f);
+	__m128 b1 = _mm_setr_ps(b->m[1][0], b->m[1][1], b->m[1][2], 0.0f);
+	__m128 b2 = _mm_setr_ps(b->m[2][0], b->m[2][1], b->m[2][2], 0.0f);
+	for (int i = 0; i < 3; i++) {
+		__m128 r = _mm_mul_ps(_mm_set1_ps(a->m[i][0]), b0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a->m[i][1]), b1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a->m[i][2]), b2));
+		float row[4];
+		_mm_storeu_ps(row, r);
+		memcpy(c->m[i], row, sizeof(c->m[i]));
+	}
+}
+
+void mat4_transform_points_sse(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	// 4 points per loop, with the matrix elements in every lane
+	__m128 m00 = _mm_set1_ps(m->m[0][0]), m01 = _mm_set1_ps(m->m[0][1]), m02 = _mm_set1_ps(m->m[0][2]), m03 = _mm_set1_ps(m->m[0][3]);
+	__m128 m10 = _mm_set1_ps(m->m[1][0]), m11 = _mm_set1_ps(m->m[1][1]), m12 = _mm_set1_ps(m->m[1][2]), m13 = _mm_set1_ps(m->m[1][3]);
+	__m128 m20 = _mm_set1_ps(m->m[2][0]), m21 = _mm_set1_ps(m->m[2][1]), m22 = _mm_set1_ps(m->m[2][2]), m23 = _mm_set1_ps(m->m[2][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 rx = _mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py));
+		_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(rx, _mm_mul_ps(m02, pz)), m03));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(ry, _mm_mul_ps(m12, pz)), m13));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py));
+		_mm_storeu_ps(out_z + i, _mm_add_ps(_mm_add_ps(rz, _mm_mul_ps(m22, pz)), m23));
+	}
+	mat4_transform_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+}
+
+void mat4_transform_points_homogeneous_sse(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	__m128 m00 = _mm_set1_ps(m->m[0][0]), m01 = _mm_set1_ps(m->m[0][1]), m02 = _mm_set1_ps(m->m[0][2]), m03 = _mm_set1_ps(m->m[0][3]);
+	__m128 m10 = _mm_set1_ps(m->m[1][0]), m11 = _mm_set1_ps(m->m[1][1]), m12 = _mm_set1_ps(m->m[1][2]), m13 = _mm_set1_ps(m->m[1][3]);
+	__m128 m20 = _mm_set1_ps(m->m[2][0]), m21 = _mm_set1_ps(m->m[2][1]), m22 = _mm_set1_ps(m->m[2][2]), m23 = _mm_set1_ps(m->m[2][3]);
+	__m128 m30 = _mm_set1_ps(m->m[3][0]), m31 = _mm_set1_ps(m->m[3][1]), m32 = _mm_set1_ps(m->m[3][2]), m33 = _mm_set1_ps(m->m[3][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 rx = _mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py));
+		_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(rx, _mm_mul_ps(m02, pz)), m03));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(ry, _mm_mul_ps(m12, pz)), m13));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py));
+		_mm_storeu_ps(out_z + i, _mm_add_ps(_mm_add_ps(rz, _mm_mul_ps(m22, pz)), m23));
+		__m128 rw = _mm_add_ps(_mm_mul_ps(m30, px), _mm_mul_ps(m31, py));
+		_mm_storeu_ps(out_w + i, _mm_add_ps(_mm_add_ps(rw, _mm_mul_ps(m32, pz)), m33));
+	}
+	mat4_transform_points_homogeneous_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, out_w + i, count - i);
+}
+
+void mat3_project_points_sse(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	__m128 m00 = _mm_set1_ps(m->m[0][0]), m01 = _mm_set1_ps(m->m[0][1]), m02 = _mm_set1_ps(m->m[0][2]);
+	__m128 m10 = _mm_set1_ps(m->m[1][0]), m11 = _mm_set1_ps(m->m[1][1]), m12 = _mm_set1_ps(m->m[1][2]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 pz = _mm_loadu_ps(z + i);
+		__m128 px = _mm_div_ps(_mm_loadu_ps(x + i), pz);
+		__m128 py = _mm_div_ps(_mm_loadu_ps(y + i), pz);
+		_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)), m02));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)), m12));
+	}
+	mat3_project_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, count - i);
+}
+
+__attribute__((target("avx")))
+void mat4_transform_points_avx(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	// 8 points per loop, with the matrix elements in every lane
+	__m256 m00 = _mm256_set1_ps(m->m[0][0]), m01 = _mm256_set1_ps(m->m[0][1]), m02 = _mm256_set1_ps(m->m[0][2]), m03 = _mm256_set1_ps(m->m[0][3]);
+	__m256 m10 = _mm256_set1_ps(m->m[1][0]), m11 = _mm256_set1_ps(m->m[1][1]), m12 = _mm256_set1_ps(m->m[1][2]), m13 = _mm256_set1_ps(m->m[1][3]);
+	__m256 m20 = _mm256_set1_ps(m->m[2][0]), m21 = _mm256_set1_ps(m->m[2][1]), m22 = _mm256_set1_ps(m->m[2][2]), m23 = _mm256_set1_ps(m->m[2][3]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 rx = _mm256_add_ps(_mm256_mul_ps(m00, px), _mm256_mul_ps(m01, py));
+		_mm256_storeu_ps(out_x + i, _mm256_add_ps(_mm256_add_ps(rx, _mm256_mul_ps(m02, pz)), m03));
+		__m256 ry = _mm256_add_ps(_mm256_mul_ps(m10, px), _mm256_mul_ps(m11, py));
+		_mm256_storeu_ps(out_y + i, _mm256_add_ps(_mm256_add_ps(ry, _mm256_mul_ps(m12, pz)), m13));
+		__m256 rz = _mm256_add_ps(_mm256_mul_ps(m20, px), _mm256_mul_ps(m21, py));
+		_mm256_storeu_ps(out_z + i, _mm256_add_ps(_mm256_add_ps(rz, _mm256_mul_ps(m22, pz)), m23));
+	}
+	// Clear the upper halves first, or the SSE code in the tail stalls
+	_mm256_zeroupper();
+	mat4_transform_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+}
+
+__attribute__((target("avx")))
+void mat4_transform_points_homogeneous_avx(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	__m256 m00 = _mm256_set1_ps(m->m[0][0]), m01 = _mm256_set1_ps(m->m[0][1]), m02 = _mm256_set1_ps(m->m[0][2]), m03 = _mm256_set1_ps(m->m[0][3]);
+	__m256 m10 = _mm256_set1_ps(m->m[1][0]), m11 = _mm256_set1_ps(m->m[1][1]), m12 = _mm256_set1_ps(m->m[1][2]), m13 = _mm256_set1_ps(m->m[1][3]);
+	__m256 m20 = _mm256_set1_ps(m->m[2][0]), m21 = _mm256_set1_ps(m->m[2][1]), m22 = _mm256_set1_ps(m->m[2][2]), m23 = _mm256_set1_ps(m->m[2][3]);
+	__m256 m30 = _mm256_set1_ps(m->m[3][0]), m31 = _mm256_set1_ps(m->m[3][1]), m32 = _mm256_set1_ps(m->m[3][2]), m33 = _mm256_set1_ps(m->m[3][3]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 rx = _mm256_add_ps(_mm256_mul_ps(m00, px), _mm256_mul_ps(m01, py));
+		_mm256_storeu_ps(out_x + i, _mm256_add_ps(_mm256_add_ps(rx, _mm256_mul_ps(m02, pz)), m03));
+		__m256 ry = _mm256_add_ps(_mm256_mul_ps(m10, px), _mm256_mul_ps(m11, py));
+		_mm256_storeu_ps(out_y + i, _mm256_add_ps(_mm256_add_ps(ry, _mm256_mul_ps(m12, pz)), m13));
+		__m256 rz = _mm256_add_ps(_mm256_mul_ps(m20, px), _mm256_mul_ps(m21, py));
+		_mm256_storeu_ps(out_z + i, _mm256_add_ps(_mm256_add_ps(rz, _mm256_mul_ps(m22, pz)), m23));
+		__m256 rw = _mm256_add_ps(_mm256_mul_ps(m30, px), _mm256_mul_ps(m31, py));
+		_mm256_storeu_ps(out_w + i, _mm256_add_ps(_mm256_add_ps(rw, _mm256_mul_ps(m32, pz)), m33));
+	}
+	// Clear the upper halves first, or the SSE code in the tail stalls
+	_mm256_zeroupper();
+	mat4_transform_points_homogeneous_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, out_w + i, count - i);
+}
+
+__attribute__((target("avx")))
+void mat3_project_points_avx(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	__m256 m00 = _mm256_set1_ps(m->m[0][0]), m01 = _mm256_set1_ps(m->m[0][1]), m02 = _mm256_set1_ps(m->m[0][2]);
+	__m256 m10 = _mm256_set1_ps(m->m[1][0]), m11 = _mm256_set1_ps(m->m[1][1]), m12 = _mm256_set1_ps(m->m[1][2]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 pz = _mm256_loadu_ps(z + i);
+		__m256 px = _mm256_div_ps(_mm256_loadu_ps(x + i), pz);
+		__m256 py = _mm256_div_ps(_mm256_loadu_ps(y + i), pz);
+		_mm256_storeu_ps(out_x + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, px), _mm256_mul_ps(m01, py)), m02));
+		_mm256_storeu_ps(out_y + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, px), _mm256_mul_ps(m11, py)), m12));
+	}
+	// Clear the upper halves first, or the SSE code in the tail stalls
+	_mm256_zeroupper();
+	mat3_project_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, count - i);
+}
+
+#endif
+
+#ifdef MATRIX_NEON_KERNELS
+
+void mat4_mul_neon(mat4_t *c, const mat4_t *a, const mat4_t *b) {
+	float32x4_t b0 = vld1q_f32(b->m[0]);
+	float32x4_t b1 = vld1q_f32(b->m[1]);
+	float32x4_t b2 = vld1q_f32(b->m[2]);
+	float32x4_t b3 = vld1q_f32(b->m[3]);
+	for (int i = 0; i < 4; i++) {
+		float32x4_t ar = vld1q_f32(a->m[i]);
+		float32x4_t r = vmulq_laneq_f32(b0, ar, 0);
+		r = vaddq_f32(r, vmulq_laneq_f32(b1, ar, 1));
+		r = vaddq_f32(r, vmulq_laneq_f32(b2, ar, 2));
+		r = vaddq_f32(r, vmulq_laneq_f32(b3, ar, 3));
+		vst1q_f32(c->m[i], r);
+	}
+}
+
+vec4_t vec4_mat4_mul_neon(vec4_t v, const mat4_t *m) {
+	float32x4_t vv = vld1q_f32(&v.x);
+	float32x4_t r0 = vmulq_f32(vld1q_f32(m->m[0]), vv);
+	float32x4_t r1 = vmulq_f32(vld1q_f32(m->m[1]), vv);
+	float32x4_t r2 = vmulq_f32(vld1q_f32(m->m[2]), vv);
+	float32x4_t r3 = vmulq_f32(vld1q_f32(m->m[3]), vv);
+	float32x4_t sum = vpaddq_f32(vpaddq_f32(r0, r1), vpaddq_f32(r2, r3));
+	vec4_t c;
+	vst1q_f32(&c.x, sum);
+	return c;
+}
+
+void mat3_mul_neon(mat3_t *c, const mat3_t *a, const mat3_t *b) {
+	float32x4_t b0 = { b->m[0][0], b->m[0][1], b->m[0][2], 0.0f };
+	float32x4_t b1 = { b->m[1][0], b->m[1][1], b->m[1][2], 0.0f };
+	float32x4_t b2 = { b->m[2][0], b->m[2][1], b->m[2][2], 0.0f };
+	for (int i = 0; i < 3; i++) {
+		float32x4_t r = vmulq_n_f32(b0, a->m[i][0]);
+		r = vaddq_f32(r, vmulq_n_f32(b1, a->m[i][1]));
+		r = vaddq_f32(r, vmulq_n_f32(b2, a->m[i][2]));
+		float row[4];
+		vst1q_f32(row, r);
+		memcpy(c->m[i], row, sizeof(c->m[i]));
+	}
+}
+
+void mat4_transform_points_neon(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	// 4 points per loop, with the matrix elements in every lane
+	float32x4_t m00 = vdupq_n_f32(m->m[0][0]), m01 = vdupq_n_f32(m->m[0][1]), m02 = vdupq_n_f32(m->m[0][2]), m03 = vdupq_n_f32(m->m[0][3]);
+	float32x4_t m10 = vdupq_n_f32(m->m[1][0]), m11 = vdupq_n_f32(m->m[1][1]), m12 = vdupq_n_f32(m->m[1][2]), m13 = vdupq_n_f32(m->m[1][3]);
+	float32x4_t m20 = vdupq_n_f32(m->m[2][0]), m21 = vdupq_n_f32(m->m[2][1]), m22 = vdupq_n_f32(m->m[2][2]), m23 = vdupq_n_f32(m->m[2][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t px = vld1q_f32(x + i), py = vld1q_f32(y + i), pz = vld1q_f32(z + i);
+		float32x4_t rx = vaddq_f32(vmulq_f32(m00, px), vmulq_f32(m01, py));
+		vst1q_f32(out_x + i, vaddq_f32(vaddq_f32(rx, vmulq_f32(m02, pz)), m03));
+		float32x4_t ry = vaddq_f32(vmulq_f32(m10, px), vmulq_f32(m11, py));
+		vst1q_f32(out_y + i, vaddq_f32(vaddq_f32(ry, vmulq_f32(m12, pz)), m13));
+		float32x4_t rz = vaddq_f32(vmulq_f32(m20, px), vmulq_f32(m21, py));
+		vst1q_f32(out_z + i, vaddq_f32(vaddq_f32(rz, vmulq_f32(m22, pz)), m23));
+	}
+	mat4_transform_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+}
+
+void mat4_transform_points_homogeneous_neon(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	float32x4_t m00 = vdupq_n_f32(m->m[0][0]), m01 = vdupq_n_f32(m->m[0][1]), m02 = vdupq_n_f32(m->m[0][2]), m03 = vdupq_n_f32(m->m[0][3]);
+	float32x4_t m10 = vdupq_n_f32(m->m[1][0]), m11 = vdupq_n_f32(m->m[1][1]), m12 = vdupq_n_f32(m->m[1][2]), m13 = vdupq_n_f32(m->m[1][3]);
+	float32x4_t m20 = vdupq_n_f32(m->m[2][0]), m21 = vdupq_n_f32(m->m[2][1]), m22 = vdupq_n_f32(m->m[2][2]), m23 = vdupq_n_f32(m->m[2][3]);
+	float32x4_t m30 = vdupq_n_f32(m->m[3][0]), m31 = vdupq_n_f32(m->m[3][1]), m32 = vdupq_n_f32(m->m[3][2]), m33 = vdupq_n_f32(m->m[3][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t px = vld1q_f32(x + i), py = vld1q_f32(y + i), pz = vld1q_f32(z + i);
+		float32x4_t rx = vaddq_f32(vmulq_f32(m00, px), vmulq_f32(m01, py));
+		vst1q_f32(out_x + i, vaddq_f32(vaddq_f32(rx, vmulq_f32(m02, pz)), m03));
+		float32x4_t ry = vaddq_f32(vmulq_f32(m10, px), vmulq_f32(m11, py));
+		vst1q_f32(out_y + i, vaddq_f32(vaddq_f32(ry, vmulq_f32(m12, pz)), m13));
+		float32x4_t rz = vaddq_f32(vmulq_f32(m20, px), vmulq_f32(m21, py));
+		vst1q_f32(out_z + i, vaddq_f32(vaddq_f32(rz, vmulq_f32(m22, pz)), m23));
+		float32x4_t rw = vaddq_f32(vmulq_f32(m30, px), vmulq_f32(m31, py));
+		vst1q_f32(out_w + i, vaddq_f32(vaddq_f32(rw, vmulq_f32(m32, pz)), m33));
+	}
+	mat4_transform_points_homogeneous_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, out_w + i, count - i);
+}
+
+void mat3_project_points_neon(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	float32x4_t m00 = vdupq_n_f32(m->m[0][0]), m01 = vdupq_n_f32(m->m[0][1]), m02 = vdupq_n_f32(m->m[0][2]);
+	float32x4_t m10 = vdupq_n_f32(m->m[1][0]), m11 = vdupq_n_f32(m->m[1][1]), m12 = vdupq_n_f32(m->m[1][2]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t pz = vld1q_f32(z + i);
+		float32x4_t px = vdivq_f32(vld1q_f32(x + i), pz);
+		float32x4_t py = vdivq_f32(vld1q_f32(y + i), pz);
+		vst1q_f32(out_x + i, vaddq_f32(vaddq_f32(vmulq_f32(m00, px), vmulq_f32(m01, py)), m02));
+		vst1q_f32(out_y + i, vaddq_f32(vaddq_f32(vmulq_f32(m10, px), vmulq_f32(m11, py)), m12));
+	}
+	mat3_project_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, count - i);
+}
+
+#endif
+
+#ifdef MATRIX_WASM
+
+void mat4_mul_simd128(mat4_t *c, const mat4_t *a, const mat4_t *b) {
+	v128_t b0 = wasm_v128_load(b->m[0]);
+	v128_t b1 = wasm_v128_load(b->m[1]);
+	v128_t b2 = wasm_v128_load(b->m[2]);
+	v128_t b3 = wasm_v128_load(b->m[3]);
+	for (int i = 0; i < 4; i++) {
+		v128_t r = wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][0]), b0);
+		r = wasm_f32x4_add(r, wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][1]), b1));
+		r = wasm_f32x4_add(r, wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][2]), b2));
+		r = wasm_f32x4_add(r, wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][3]), b3));
+		wasm_v128_store(c->m[i], r);
+	}
+}
+
+vec4_t vec4_mat4_mul_simd128(vec4_t v, const mat4_t *m) {
+	v128_t vv = wasm_f32x4_make(v.x, v.y, v.z, v.w);
+	v128_t r0 = wasm_f32x4_mul(wasm_v128_load(m->m[0]), vv);
+	v128_t r1 = wasm_f32x4_mul(wasm_v128_load(m->m[1]), vv);
+	v128_t r2 = wasm_f32x4_mul(wasm_v128_load(m->m[2]), vv);
+	v128_t r3 = wasm_f32x4_mul(wasm_v128_load(m->m[3]), vv);
+	v128_t s01 = wasm_f32x4_add(wasm_i32x4_shuffle(r0, r1, 0, 4, 1, 5), wasm_i32x4_shuffle(r0, r1, 2, 6, 3, 7));
+	v128_t s23 = wasm_f32x4_add(wasm_i32x4_shuffle(r2, r3, 0, 4, 1, 5), wasm_i32x4_shuffle(r2, r3, 2, 6, 3, 7));
+	v128_t sum = wasm_f32x4_add(wasm_i32x4_shuffle(s01, s23, 0, 1, 4, 5), wasm_i32x4_shuffle(s01, s23, 2, 3, 6, 7));
+	vec4_t c;
+	wasm_v128_store(&c.x, sum);
+	return c;
+}
+
+void mat3_mul_simd128(mat3_t *c, const mat3_t *a, const mat3_t *b) {
+	v128_t b0 = wasm_f32x4_make(b->m[0][0], b->m[0][1], b->m[0][2], 0.0f);
+	v128_t b1 = wasm_f32x4_make(b->m[1][0], b->m[1][1], b->m[1][2], 0.0f);
+	v128_t b2 = wasm_f32x4_make(b->m[2][0], b->m[2][1], b->m[2][2], 0.0f);
+	for (int i = 0; i < 3; i++) {
+		v128_t r = wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][0]), b0);
+		r = wasm_f32x4_add(r, wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][1]), b1));
+		r = wasm_f32x4_add(r, wasm_f32x4_mul(wasm_f32x4_splat(a->m[i][2]), b2));
+		float row[4];
+		wasm_v128_store(row, r);
+		memcpy(c->m[i], row, sizeof(c->m[i]));
+	}
+}
+
+void mat4_transform_points_simd128(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count) {
+	// 4 points per loop, with the matrix elements in every lane
+	v128_t m00 = wasm_f32x4_splat(m->m[0][0]), m01 = wasm_f32x4_splat(m->m[0][1]), m02 = wasm_f32x4_splat(m->m[0][2]), m03 = wasm_f32x4_splat(m->m[0][3]);
+	v128_t m10 = wasm_f32x4_splat(m->m[1][0]), m11 = wasm_f32x4_splat(m->m[1][1]), m12 = wasm_f32x4_splat(m->m[1][2]), m13 = wasm_f32x4_splat(m->m[1][3]);
+	v128_t m20 = wasm_f32x4_splat(m->m[2][0]), m21 = wasm_f32x4_splat(m->m[2][1]), m22 = wasm_f32x4_splat(m->m[2][2]), m23 = wasm_f32x4_splat(m->m[2][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v128_t px = wasm_v128_load(x + i), py = wasm_v128_load(y + i), pz = wasm_v128_load(z + i);
+		v128_t rx = wasm_f32x4_add(wasm_f32x4_mul(m00, px), wasm_f32x4_mul(m01, py));
+		wasm_v128_store(out_x + i, wasm_f32x4_add(wasm_f32x4_add(rx, wasm_f32x4_mul(m02, pz)), m03));
+		v128_t ry = wasm_f32x4_add(wasm_f32x4_mul(m10, px), wasm_f32x4_mul(m11, py));
+		wasm_v128_store(out_y + i, wasm_f32x4_add(wasm_f32x4_add(ry, wasm_f32x4_mul(m12, pz)), m13));
+		v128_t rz = wasm_f32x4_add(wasm_f32x4_mul(m20, px), wasm_f32x4_mul(m21, py));
+		wasm_v128_store(out_z + i, wasm_f32x4_add(wasm_f32x4_add(rz, wasm_f32x4_mul(m22, pz)), m23));
+	}
+	mat4_transform_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+}
+
+void mat4_transform_points_homogeneous_simd128(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count) {
+	v128_t m00 = wasm_f32x4_splat(m->m[0][0]), m01 = wasm_f32x4_splat(m->m[0][1]), m02 = wasm_f32x4_splat(m->m[0][2]), m03 = wasm_f32x4_splat(m->m[0][3]);
+	v128_t m10 = wasm_f32x4_splat(m->m[1][0]), m11 = wasm_f32x4_splat(m->m[1][1]), m12 = wasm_f32x4_splat(m->m[1][2]), m13 = wasm_f32x4_splat(m->m[1][3]);
+	v128_t m20 = wasm_f32x4_splat(m->m[2][0]), m21 = wasm_f32x4_splat(m->m[2][1]), m22 = wasm_f32x4_splat(m->m[2][2]), m23 = wasm_f32x4_splat(m->m[2][3]);
+	v128_t m30 = wasm_f32x4_splat(m->m[3][0]), m31 = wasm_f32x4_splat(m->m[3][1]), m32 = wasm_f32x4_splat(m->m[3][2]), m33 = wasm_f32x4_splat(m->m[3][3]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v128_t px = wasm_v128_load(x + i), py = wasm_v128_load(y + i), pz = wasm_v128_load(z + i);
+		v128_t rx = wasm_f32x4_add(wasm_f32x4_mul(m00, px), wasm_f32x4_mul(m01, py));
+		wasm_v128_store(out_x + i, wasm_f32x4_add(wasm_f32x4_add(rx, wasm_f32x4_mul(m02, pz)), m03));
+		v128_t ry = wasm_f32x4_add(wasm_f32x4_mul(m10, px), wasm_f32x4_mul(m11, py));
+		wasm_v128_store(out_y + i, wasm_f32x4_add(wasm_f32x4_add(ry, wasm_f32x4_mul(m12, pz)), m13));
+		v128_t rz = wasm_f32x4_add(wasm_f32x4_mul(m20, px), wasm_f32x4_mul(m21, py));
+		wasm_v128_store(out_z + i, wasm_f32x4_add(wasm_f32x4_add(rz, wasm_f32x4_mul(m22, pz)), m23));
+		v128_t rw = wasm_f32x4_add(wasm_f32x4_mul(m30, px), wasm_f32x4_mul(m31, py));
+		wasm_v128_store(out_w + i, wasm_f32x4_add(wasm_f32x4_add(rw, wasm_f32x4_mul(m32, pz)), m33));
+	}
+	mat4_transform_points_homogeneous_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, out_w + i, count - i);
+}
+
+void mat3_project_points_simd128(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count) {
+	v128_t m00 = wasm_f32x4_splat(m->m[0][0]), m01 = wasm_f32x4_splat(m->m[0][1]), m02 = wasm_f32x4_splat(m->m[0][2]);
+	v128_t m10 = wasm_f32x4_splat(m->m[1][0]), m11 = wasm_f32x4_splat(m->m[1][1]), m12 = wasm_f32x4_splat(m->m[1][2]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v128_t pz = wasm_v128_load(z + i);
+		v128_t px = wasm_f32x4_div(wasm_v128_load(x + i), pz);
+		v128_t py = wasm_f32x4_div(wasm_v128_load(y + i), pz);
+		wasm_v128_store(out_x + i, wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(m00, px), wasm_f32x4_mul(m01, py)), m02));
+		wasm_v128_store(out_y + i, wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(m10, px), wasm_f32x4_mul(m11, py)), m12));
+	}
+	mat3_project_points_scalar(m, x + i, y + i, z + i, out_x + i, out_y + i, count - i);
+}
+
+#endif
+
+#pragma mark - Dispatch
+
+bool matrix_use_kernel(matrix_kernel_t kernel) {
+	if (kernel == MATRIX_AUTO) {
+#if defined(MATRIX_NEON_KERNELS)
+		kernel = MATRIX_NEON;
+#elif defined(MATRIX_X86)
+		__builtin_cpu_init();
+		kernel = __builtin_cpu_supports("avx")? MATRIX_AVX : MATRIX_SSE;
+#elif defined(MATRIX_WASM)
+		kernel = MATRIX_SIMD128;
+#else
+		kernel = MATRIX_SCALAR;
+#endif
+	}
+	
+	switch (kernel) {
+	case MATRIX_SCALAR:
+		mat4_mul_func = mat4_mul_scalar;
+		vec4_mat4_mul_func = vec4_mat4_mul_scalar;
+		mat3_mul_func = mat3_mul_scalar;
+		mat4_transform_points_func = mat4_transform_points_scalar;
+		mat4_transform_points_homogeneous_func = mat4_transform_points_homogeneous_scalar;
+		mat3_project_points_func = mat3_project_points_scalar;
+		break;
+#ifdef MATRIX_X86
+	case MATRIX_SSE:
+		mat4_mul_func = mat4_mul_sse;
+		vec4_mat4_mul_func = vec4_mat4_mul_sse;
+		mat3_mul_func = mat3_mul_sse;
+		mat4_transform_points_func = mat4_transform_points_sse;
+		mat4_transform_points_homogeneous_func = mat4_transform_points_homogeneous_sse;
+		mat3_project_points_func = mat3_project_points_sse;
+		break;
+	case MATRIX_AVX:
+		// Single vectors and mat3 are too small for 256-bit vectors
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("avx")) return false;
+		mat4_mul_func = mat4_mul_avx;
+		vec4_mat4_mul_func = vec4_mat4_mul_sse;
+		mat3_mul_func = mat3_mul_sse;
+		mat4_transform_points_func = mat4_transform_points_avx;
+		mat4_transform_points_homogeneous_func = mat4_transform_points_homogeneous_avx;
+		mat3_project_points_func = mat3_project_points_avx;
+		break;
+#endif
+#ifdef MATRIX_NEON_KERNELS
+	case MATRIX_NEON:
+		mat4_mul_func = mat4_mul_neon;
+		vec4_mat4_mul_func = vec4_mat4_mul_neon;
+		mat3_mul_func = mat3_mul_neon;
+		mat4_transform_points_func = mat4_transform_points_neon;
+		mat4_transform_points_homogeneous_func = mat4_transform_points_homogeneous_neon;
+		mat3_project_points_func = mat3_project_points_neon;
+		break;
+#endif
+#ifdef MATRIX_WASM
+	case MATRIX_SIMD128:
+		mat4_mul_func = mat4_mul_simd128;
+		vec4_mat4_mul_func = vec4_mat4_mul_simd128;
+		mat3_mul_func = mat3_mul_simd128;
+		mat4_transform_points_func = mat4_transform_points_simd128;
+		mat4_transform_points_homogeneous_func = mat4_transform_points_homogeneous_simd128;
+		mat3_project_points_func = mat3_project_points_simd128;
+		break;
+#endif
+	default:
+		return false;
+	}
+	matrix_kernel = kernel;
+	return true;
+}
+
+matrix_kernel_t matrix_current_kernel(void) {
+	if (!mat4_mul_func) matrix_use_kernel(MATRIX_AUTO);
+	return matrix_kernel;
+}
+
+const char *matrix_kernel_name(matrix_kernel_t kernel) {
+	switch (kernel) {
+	case MATRIX_AUTO: return "auto";
+	case MATRIX_SCALAR: return "scalar";
+	case MATRIX_SSE: return "sse";
+	case MATRIX_AVX: return "avx";
+	case MATRIX_NEON: return "neon";
+	case MATRIX_SIMD128: return "simd128";
 	}
-	vec4_t result = { c[0], c[1], c[2], c[3] };
-	return result;
+	return "unknown";
 }
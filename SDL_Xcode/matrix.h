@@ -10,29 +10,55 @@
 
 #include "vector.h"
 
+#include <stdbool.h>
+
 // Matrix types
 
 typedef struct {
 	float m[3][3];
 } mat3_t;
 
+// Rows are 16-byte aligned so the SIMD kernels can load them directly.
+// Heap allocations holding a mat4_t must be 16-byte aligned too, which
+// malloc() is on the 64-bit platforms we build for.
 typedef struct {
-	float m[4][4];
+	_Alignas(16) float m[4][4];
 } mat4_t;
 
+// Affine transform: a mat4_t without the constant last row (0, 0, 0, 1)
+typedef struct {
+	_Alignas(16) float m[3][4];
+} mat34_t;
+
+// Kernels for mat4_mul(), vec4_mat4_mul() and mat3_mul().
+// MATRIX_AUTO picks the widest one the CPU supports.
+typedef enum {
+	MATRIX_AUTO,
+	MATRIX_SCALAR,
+	MATRIX_SSE,
+	MATRIX_AVX,
+	MATRIX_NEON,
+	MATRIX_SIMD128 // WebAssembly
+} matrix_kernel_t;
+
+bool matrix_use_kernel(matrix_kernel_t kernel);
+matrix_kernel_t matrix_current_kernel(void);
+const char *matrix_kernel_name(matrix_kernel_t kernel);
+
 
 // 2D Matrix Functions
-mat3_t mat3_identity(void);
+VECMATH_FUNC mat3_t mat3_identity(void);
 mat3_t mat3_translate(mat3_t m, vec2_t t);
 mat3_t mat3_scale(mat3_t m, vec2_t s);
 mat3_t mat3_rotate(mat3_t m, float a);
 mat3_t mat3_mul(const mat3_t a, const mat3_t b);
-vec2_t vec2_mat3_mul(const vec2_t a, const mat3_t m);
-vec3_t vec3_mat3_mul(const vec3_t a, const mat3_t m);
+VECMATH_FUNC vec2_t vec2_mat3_mul(const vec2_t a, const mat3_t m);
+VECMATH_FUNC vec3_t vec3_mat3_mul(const vec3_t a, const mat3_t m);
 
 // 3D Matrix Functions
-mat4_t mat4_identity(void);
+VECMATH_FUNC mat4_t mat4_identity(void);
 mat4_t mat4_perspective_matrix(float fov, float aspect, float znear, float zfar);
+mat4_t mat4_viewport_matrix(float width, float height);
 mat4_t mat4_translate(mat4_t m, vec3_t t);
 mat4_t mat4_scale(mat4_t m, vec3_t s);
 mat4_t mat4_rot_x(mat4_t m, float a);
@@ -40,7 +66,34 @@ mat4_t mat4_rot_y(mat4_t m, float a);
 mat4_t mat4_rot_z(mat4_t m, float a);
 mat4_t mat4_apply_euler_angles(mat4_t m, vec3_t a);
 mat4_t mat4_mul(const mat4_t a, const mat4_t b);
-vec3_t vec3_mat4_mul(const vec3_t v, const mat4_t m);
+VECMATH_FUNC vec3_t vec3_mat4_mul(const vec3_t v, const mat4_t m);
 vec4_t vec4_mat4_mul(const vec4_t a, const mat4_t m);
 
+// Affine Matrix Functions
+// Like the mat4 functions, mat34_translate(), mat34_scale() and mat34_rot_*()
+// apply their transform before m. They only touch the parts of m that change.
+VECMATH_FUNC mat34_t mat34_identity(void);
+VECMATH_FUNC mat34_t mat34_translate(mat34_t m, vec3_t t);
+VECMATH_FUNC mat34_t mat34_pre_translate(mat34_t m, vec3_t t); // Translates after m instead
+VECMATH_FUNC mat34_t mat34_scale(mat34_t m, vec3_t s);
+VECMATH_FUNC mat34_t mat34_rot_x(mat34_t m, float a);
+VECMATH_FUNC mat34_t mat34_rot_y(mat34_t m, float a);
+VECMATH_FUNC mat34_t mat34_rot_z(mat34_t m, float a);
+VECMATH_FUNC mat34_t mat34_mul(const mat34_t a, const mat34_t b);
+VECMATH_FUNC vec3_t vec3_mat34_mul(const vec3_t v, const mat34_t m);
+VECMATH_FUNC mat4_t mat4_from_mat34(const mat34_t m);
+VECMATH_FUNC mat34_t mat34_from_mat4(const mat4_t m); // Drops the last row
+
+// Batch Functions
+// Points are in structure-of-arrays layout: point i is (x[i], y[i], z[i]).
+// The output arrays may be the same as the input arrays. 4 or 8 points are
+// done per instruction, depending on the kernel.
+void mat4_transform_points(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, int count); // m must be affine: w is 1 and the last row is ignored
+void mat4_transform_points_homogeneous(const mat4_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, float *out_z, float *out_w, int count); // Input w is 1, output w is not divided out
+void mat3_project_points(const mat3_t *m, const float *x, const float *y, const float *z, float *out_x, float *out_y, int count); // Divides x and y by z, then applies m
+
+#ifdef VECMATH_INLINE
+#include "matrix_impl.h"
+#endif
+
 #endif /* matrix_h */
@@ -0,0 +1,155 @@
+//
+//  matrix_impl.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/13/24.
+//
+
+// Bodies of the matrix functions that do not go through a kernel. Included
+// by matrix.c, or by matrix.h itself when VECMATH_INLINE is defined. Do not
+// include this file directly.
+
+#include "trig.h"
+#include <string.h>
+
+#pragma mark - 2D Matrix
+
+VECMATH_FUNC mat3_t mat3_identity(void) {
+	mat3_t m = {
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1
+	};
+	return m;
+}
+
+VECMATH_FUNC vec2_t vec2_mat3_mul(const vec2_t v, const mat3_t m) {
+	vec2_t b;
+	b.x = m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2];
+	b.y = m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2];
+	//float w = m[2][0] * a.x + m[2][1] * a.y + m[2][2];
+	return b;
+}
+
+VECMATH_FUNC vec3_t vec3_mat3_mul(const vec3_t a, const mat3_t m) {
+	vec3_t b;
+	b.x = m.m[0][0] * a.x + m.m[0][1] * a.y + m.m[0][2] * a.z;
+	b.y = m.m[1][0] * a.x + m.m[1][1] * a.y + m.m[1][2] * a.z;
+	b.z = m.m[2][0] * a.x + m.m[2][1] * a.y + m.m[2][2] * a.z;
+	return b;
+}
+
+#pragma mark - 3D Matrix
+
+VECMATH_FUNC mat4_t mat4_identity(void) {
+	mat4_t m = {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1
+	};
+	return m;
+}
+
+VECMATH_FUNC vec3_t vec3_mat4_mul(const vec3_t v, const mat4_t m) {
+	vec4_t a = vec3_to_vec4(v);
+	vec4_t b = vec4_mat4_mul(a, m);
+	return vec4_to_vec3(b);
+}
+
+#pragma mark - Affine Matrix
+
+VECMATH_FUNC mat34_t mat34_identity(void) {
+	mat34_t m = {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0
+	};
+	return m;
+}
+
+VECMATH_FUNC mat34_t mat34_translate(mat34_t m, vec3_t t) {
+	// m * T: only the translation column changes
+	for (int i = 0; i < 3; i++) {
+		m.m[i][3] += m.m[i][0] * t.x + m.m[i][1] * t.y + m.m[i][2] * t.z;
+	}
+	return m;
+}
+
+VECMATH_FUNC mat34_t mat34_pre_translate(mat34_t m, vec3_t t) {
+	// T * m
+	m.m[0][3] += t.x;
+	m.m[1][3] += t.y;
+	m.m[2][3] += t.z;
+	return m;
+}
+
+VECMATH_FUNC mat34_t mat34_scale(mat34_t m, vec3_t s) {
+	// m * S: scales the first three columns
+	for (int i = 0; i < 3; i++) {
+		m.m[i][0] *= s.x;
+		m.m[i][1] *= s.y;
+		m.m[i][2] *= s.z;
+	}
+	return m;
+}
+
+VECMATH_FUNC mat34_t mat34_rotate_columns(mat34_t m, int j, int k, float a) {
+	// m * R, where R rotates from axis j toward axis k: only columns j and k change
+	float s, c;
+	trig_sincos(a, &s, &c);
+	for (int i = 0; i < 3; i++) {
+		float mj = m.m[i][j], mk = m.m[i][k];
+		m.m[i][j] = mj * c + mk * s;
+		m.m[i][k] = mk * c - mj * s;
+	}
+	return m;
+}
+
+VECMATH_FUNC mat34_t mat34_rot_x(mat34_t m, float a) {
+	return mat34_rotate_columns(m, 1, 2, a);
+}
+
+VECMATH_FUNC mat34_t mat34_rot_y(mat34_t m, float a) {
+	return mat34_rotate_columns(m, 2, 0, a);
+}
+
+VECMATH_FUNC mat34_t mat34_rot_z(mat34_t m, float a) {
+	return mat34_rotate_columns(m, 0, 1, a);
+}
+
+VECMATH_FUNC mat34_t mat34_mul(const mat34_t a, const mat34_t b) {
+	// 36 multiplies instead of 64, since the last rows are constant
+	mat34_t c;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			c.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+		}
+		c.m[i][3] += a.m[i][3];
+	}
+	return c;
+}
+
+VECMATH_FUNC vec3_t vec3_mat34_mul(const vec3_t v, const mat34_t m) {
+	vec3_t r;
+	r.x = m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2] * v.z + m.m[0][3];
+	r.y = m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2] * v.z + m.m[1][3];
+	r.z = m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z + m.m[2][3];
+	return r;
+}
+
+VECMATH_FUNC mat4_t mat4_from_mat34(const mat34_t m) {
+	mat4_t r;
+	memcpy(r.m, m.m, sizeof(m.m));
+	r.m[3][0] = 0;
+	r.m[3][1] = 0;
+	r.m[3][2] = 0;
+	r.m[3][3] = 1;
+	return r;
+}
+
+VECMATH_FUNC mat34_t mat34_from_mat4(const mat4_t m) {
+	mat34_t r;
+	memcpy(r.m, m.m, sizeof(r.m));
+	return r;
+}
@@ -0,0 +1,188 @@
+//
+//  memfill.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/2/24.
+//
+
+#include "memfill.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define MEMFILL_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*memfill32_func_t)(uint32_t *dst, uint32_t value, size_t count);
+
+memfill32_func_t memfill32_func = NULL;
+memfill_kernel_t memfill_kernel = MEMFILL_AUTO;
+
+
+#pragma mark - Kernels
+
+void memfill32_scalar(uint32_t *dst, uint32_t value, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = value;
+	}
+}
+
+#ifdef MEMFILL_X86
+
+void memfill32_sse2(uint32_t *dst, uint32_t value, size_t count) {
+	// Head: store single pixels until dst is 16-byte aligned
+	while (count > 0 && ((uintptr_t)dst & 15) != 0) {
+		*dst++ = value;
+		count--;
+	}
+	
+	__m128i v = _mm_set1_epi32((int)value);
+	size_t blocks = count / 16;
+	__m128i *p = (__m128i *)dst;
+	if (count * sizeof(uint32_t) > MEMFILL_STREAMING_THRESHOLD) {
+		for (size_t i = 0; i < blocks; i++, p += 4) {
+			_mm_stream_si128(p + 0, v);
+			_mm_stream_si128(p + 1, v);
+			_mm_stream_si128(p + 2, v);
+			_mm_stream_si128(p + 3, v);
+		}
+		_mm_sfence();
+	} else {
+		for (size_t i = 0; i < blocks; i++, p += 4) {
+			_mm_store_si128(p + 0, v);
+			_mm_store_si128(p + 1, v);
+			_mm_store_si128(p + 2, v);
+			_mm_store_si128(p + 3, v);
+		}
+	}
+	
+	// Tail
+	memfill32_scalar(dst + blocks * 16, value, count % 16);
+}
+
+__attribute__((target("avx2")))
+void memfill32_avx2(uint32_t *dst, uint32_t value, size_t count) {
+	// Head: store single pixels until dst is 32-byte aligned
+	while (count > 0 && ((uintptr_t)dst & 31) != 0) {
+		*dst++ = value;
+		count--;
+	}
+	
+	__m256i v = _mm256_set1_epi32((int)value);
+	size_t blocks = count / 32;
+	__m256i *p = (__m256i *)dst;
+	if (count * sizeof(uint32_t) > MEMFILL_STREAMING_THRESHOLD) {
+		for (size_t i = 0; i < blocks; i++, p += 4) {
+			_mm256_stream_si256(p + 0, v);
+			_mm256_stream_si256(p + 1, v);
+			_mm256_stream_si256(p + 2, v);
+			_mm256_stream_si256(p + 3, v);
+		}
+		_mm_sfence();
+	} else {
+		for (size_t i = 0; i < blocks; i++, p += 4) {
+			_mm256_store_si256(p + 0, v);
+			_mm256_store_si256(p + 1, v);
+			_mm256_store_si256(p + 2, v);
+			_mm256_store_si256(p + 3, v);
+		}
+	}
+	
+	// Tail
+	memfill32_scalar(dst + blocks * 32, value, count % 32);
+}
+
+#endif
+
+#ifdef __ARM_NEON
+
+void memfill32_neon(uint32_t *dst, uint32_t value, size_t count) {
+	// NEON has no non-temporal store for general use, but STP of q registers
+	// is already as wide as the store path.
+	uint32x4_t v = vdupq_n_u32(value);
+	size_t blocks = count / 16;
+	for (size_t i = 0; i < blocks; i++, dst += 16) {
+		vst1q_u32(dst + 0, v);
+		vst1q_u32(dst + 4, v);
+		vst1q_u32(dst + 8, v);
+		vst1q_u32(dst + 12, v);
+	}
+	memfill32_scalar(dst, value, count % 16);
+}
+
+#endif
+
+#pragma mark - Dispatch
+
+bool memfill_use_kernel(memfill_kernel_t kernel) {
+	if (kernel == MEMFILL_AUTO) {
+#if defined(__ARM_NEON)
+		kernel = MEMFILL_NEON;
+#elif defined(MEMFILL_X86)
+		__builtin_cpu_init();
+		kernel = __builtin_cpu_supports("avx2")? MEMFILL_AVX2 : MEMFILL_SSE2;
+#else
+		kernel = MEMFILL_SCALAR;
+#endif
+	}
+	
+	switch (kernel) {
+	case MEMFILL_SCALAR:
+		memfill32_func = memfill32_scalar;
+		break;
+#ifdef MEMFILL_X86
+	case MEMFILL_SSE2:
+		memfill32_func = memfill32_sse2;
+		break;
+	case MEMFILL_AVX2:
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("avx2")) return false;
+		memfill32_func = memfill32_avx2;
+		break;
+#endif
+#ifdef __ARM_NEON
+	case MEMFILL_NEON:
+		memfill32_func = memfill32_neon;
+		break;
+#endif
+	default:
+		return false;
+	}
+	memfill_kernel = kernel;
+	return true;
+}
+
+memfill_kernel_t memfill_current_kernel(void) {
+	if (!memfill32_func) memfill_use_kernel(MEMFILL_AUTO);
+	return memfill_kernel;
+}
+
+const char *memfill_kernel_name(memfill_kernel_t kernel) {
+	switch (kernel) {
+	case MEMFILL_AUTO: return "auto";
+	case MEMFILL_SCALAR: return "scalar";
+	case MEMFILL_SSE2: return "sse2";
+	case MEMFILL_AVX2: return "avx2";
+	case MEMFILL_NEON: return "neon";
+	}
+	return "unknown";
+}
+
+#pragma mark -
+
+void memfill32(uint32_t *dst, uint32_t value, size_t count) {
+	// The kernel is chosen on first use
+	if (!memfill32_func) memfill_use_kernel(MEMFILL_AUTO);
+	memfill32_func(dst, value, count);
+}
+
+void memfill16(uint16_t *dst, uint16_t value, size_t count) {
+	// Fills pairs of 16-bit values with the 32-bit kernel
+	if (count > 0 && ((uintptr_t)dst & 2) != 0) {
+		*dst++ = value;
+		count--;
+	}
+	memfill32((uint32_t *)dst, ((uint32_t)value << 16) | value, count / 2);
+	if (count % 2) dst[count - 1] = value;
+}
@@ -0,0 +1,35 @@
+//
+//  memfill.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/2/24.
+//
+
+#ifndef memfill_h
+#define memfill_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fill kernels. MEMFILL_AUTO picks the widest one the CPU supports.
+typedef enum {
+	MEMFILL_AUTO,
+	MEMFILL_SCALAR,
+	MEMFILL_SSE2,
+	MEMFILL_AVX2,
+	MEMFILL_NEON
+} memfill_kernel_t;
+
+// Buffers larger than this (in bytes) are filled with non-temporal stores,
+// since they would not stay in the cache anyway.
+#define MEMFILL_STREAMING_THRESHOLD (1024 * 1024)
+
+void memfill32(uint32_t *dst, uint32_t value, size_t count);
+void memfill16(uint16_t *dst, uint16_t value, size_t count);
+
+bool memfill_use_kernel(memfill_kernel_t kernel);
+memfill_kernel_t memfill_current_kernel(void);
+const char *memfill_kernel_name(memfill_kernel_t kernel);
+
+#endif /* memfill_h */
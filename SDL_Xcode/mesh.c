@@ -11,6 +11,8 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 /*
  Vertex numbering
@@ -23,13 +25,10 @@
  */
 
 
-// Face (triangle)
-typedef struct {
-	int a, b, c;
-} face_t;
-
+// Projected triangle. Clipped faces are split into several triangles.
 typedef struct {
 	vec2_t a, b, c;
+	float depth[3];
 } triangle_t;
 
 // Number of points in the mesh
@@ -47,7 +46,7 @@ vec3_t cube_vertices[CUBE_VERTICES_LEN] = {
 
 // Number of faces: 6 for each cube face * 2 for triangles per face
 #define CUBE_FACES_LEN (12)
-face_t cube_faces[CUBE_FACES_LEN] = {
+mesh_face_t cube_faces[CUBE_FACES_LEN] = {
 	// front
 	{ 0, 2, 1 },
 	{ 0, 3, 2 },
@@ -72,40 +71,75 @@ face_t cube_faces[CUBE_FACES_LEN] = {
 #define PROJECTED_POINTS_LEN (256)
 vec2_t projected_points[PROJECTED_POINTS_LEN];
 
+// Projected triangles of the visible faces, reused from frame to frame
+triangle_t *projected_triangles = NULL;
+int projected_triangles_len = 0;
+
+// Whether each face passed culling in the current draw, for drawing edges
+uint8_t *face_visible = NULL;
+int face_visible_len = 0;
+
+// One bit for each vertex of a visible face that is inside the clip planes,
+// so that each point is drawn once however many faces share it
+uint64_t *vertex_visible = NULL;
+int vertex_visible_len = 0; // In words
+
+// Mesh vertices in structure-of-arrays layout, reused from frame to frame.
+// The float arrays share one allocation.
+float *vertex_buffer = NULL;
+float *vertex_x, *vertex_y, *vertex_z; // Model space
+clip_vertices_t clip_vertices;
+int vertex_buffer_len = 0;
+
 
 #pragma mark -
 
 mesh_t *mesh_new_cube(void) {
-	mesh_t *mesh = mesh_new(CUBE_FACES_LEN);
+	mesh_t *mesh = mesh_new(CUBE_VERTICES_LEN, CUBE_FACES_LEN);
 	if (!mesh) return NULL;
 
-	mesh_face_t *f = mesh->faces;
+	for (int i=0; i<CUBE_VERTICES_LEN; i++) {
+		mesh->vertices[i] = cube_vertices[i];
+	}
 	for (int i=0; i<CUBE_FACES_LEN; i++) {
-		f[i].a = cube_vertices[cube_faces[i].a];
-		f[i].b = cube_vertices[cube_faces[i].b];
-		f[i].c = cube_vertices[cube_faces[i].c];
+		mesh->faces[i] = cube_faces[i];
 	}
 	
 	return mesh;
 }
 
-mesh_t *mesh_new(int faces) {
+mesh_t *mesh_new(int vertices, int faces) {
 	mesh_t *mesh = malloc(sizeof(mesh_t));
 	if (!mesh) return NULL;
 
 	// Geometry
+	mesh->vertex_count = vertices;
+	mesh->vertices = NULL;
 	mesh->face_count = faces;
 	mesh->faces = NULL;
+	mesh->mapping = NULL;
+	mesh->mapping_size = 0;
+	mesh->edge_count = 0;
+	mesh->edges = NULL;
+	if (vertices > 0) {
+		mesh->vertices = malloc(sizeof(vec3_t) * (size_t)vertices);
+	}
 	if (faces > 0) {
 		mesh->faces = malloc(sizeof(mesh_face_t) * (size_t)faces);
 	}
+	if ((vertices > 0 && !mesh->vertices) || (faces > 0 && !mesh->faces)) {
+		mesh_destroy(mesh);
+		return NULL;
+	}
 	
 	// Visuals
+	mesh->fill_color = 0;
 	mesh->line_color = ABGR_WHITE;
 	mesh->point_color = 0;
+	mesh->hide_coplanar_edges = false;
 
 	// Physics
-	mesh->rotation = mat4_identity();
+	mesh->orientation = quat_identity();
 	mesh->scale = vec3_make(1, 1, 1);
 	mesh->position = vec3_zero();
 	mesh->linear_momentum = vec3_zero();
@@ -115,77 +149,348 @@ mesh_t *mesh_new(int faces) {
 	return mesh;
 }
 
-void cube_destroy(mesh_t *mesh) {
-	if (mesh->faces) free(mesh->faces);
+void mesh_destroy(mesh_t *mesh) {
+	if (mesh->mapping) {
+		munmap(mesh->mapping, mesh->mapping_size);
+	} else {
+		if (mesh->vertices) free(mesh->vertices);
+		if (mesh->faces) free(mesh->faces);
+	}
+	if (mesh->edges) free(mesh->edges);
 	free(mesh);
 }
 
+void mesh_normalize(mesh_t *mesh) {
+	// Centers the bounding box on the origin and scales the largest half-extent to 1
+	if (mesh->vertex_count == 0) return;
+	vec3_t lo = mesh->vertices[0], hi = mesh->vertices[0];
+	for (int i = 1; i < mesh->vertex_count; i++) {
+		vec3_t v = mesh->vertices[i];
+		lo = vec3_make(fminf(lo.x, v.x), fminf(lo.y, v.y), fminf(lo.z, v.z));
+		hi = vec3_make(fmaxf(hi.x, v.x), fmaxf(hi.y, v.y), fmaxf(hi.z, v.z));
+	}
+	vec3_t center = vec3_mul(vec3_add(lo, hi), 0.5f);
+	float extent = fmaxf(hi.x - lo.x, fmaxf(hi.y - lo.y, hi.z - lo.z)) * 0.5f;
+	float s = (extent > 0.0f)? 1.0f / extent : 1.0f;
+	for (int i = 0; i < mesh->vertex_count; i++) {
+		mesh->vertices[i] = vec3_mul(vec3_sub(mesh->vertices[i], center), s);
+	}
+}
+
 void mesh_update(mesh_t *mesh, double delta_time) {
 	mesh->lifetime += delta_time;
 	
-	// Update rotation
-	vec3_t rad = vec3_mul(mesh->angular_momentum, (float)(M_PI / 180.0 * delta_time));
-	mat4_t increment = mat4_apply_euler_angles(mat4_identity(), rad);
-	mesh->rotation = mat4_mul(mesh->rotation, increment);
+	// Update rotation. The step is one rotation about the axis of the angular
+	// velocity. Before orientations were quaternions, it was three rotations,
+	// one per axis in the order of mat4_apply_euler_angles(). The two agree
+	// for a spin about one axis, but spins about several axes now tumble along
+	// a slightly different path, which depends less on the frame rate.
+	vec3_t velocity = vec3_mul(mesh->angular_momentum, (float)(M_PI / 180.0));
+	mesh->orientation = quat_integrate(mesh->orientation, velocity, (float)delta_time);
 	
-	// Update position
-	mesh->position = vec3_add(mesh->position, mesh->linear_momentum);
+	// Update position. Momentum is in meters/second, so it is scaled by the time step.
+	mesh->position = vec3_add(mesh->position, vec3_mul(mesh->linear_momentum, (float)delta_time));
+}
+
+
+#pragma mark - Edges
+
+vec3_t face_normal(const mesh_t *mesh, mesh_face_t f) {
+	vec3_t a = mesh->vertices[f.a];
+	vec3_t u = vec3_sub(mesh->vertices[f.b], a);
+	vec3_t v = vec3_sub(mesh->vertices[f.c], a);
+	return vec3_cross(u, v);
 }
 
+bool faces_coplanar(const mesh_t *mesh, int f0, int f1) {
+	// The normals point the same way to within about a quarter of a degree
+	vec3_t n0 = face_normal(mesh, mesh->faces[f0]);
+	vec3_t n1 = face_normal(mesh, mesh->faces[f1]);
+	float d = vec3_dot(n0, n1);
+	float l = vec3_dot(n0, n0) * vec3_dot(n1, n1);
+	return d > 0.0f && d * d >= 0.99998f * l;
+}
+
+bool mesh_build_edges(mesh_t *mesh) {
+	// Lists each edge once with the faces on either side. Every face adds 3
+	// half-edges, bucketed by their lower vertex, so matching a half-edge to
+	// its twin only searches the few edges of one vertex. Call again after
+	// changing the faces.
+	int vertex_count = mesh->vertex_count;
+	int half_count = mesh->face_count * 3;
+	int *start = calloc((size_t)vertex_count + 1, sizeof(int));
+	int *half = malloc(sizeof(int) * 3 * (size_t)half_count); // From, to and face
+	mesh_edge_t *edges = malloc(sizeof(mesh_edge_t) * (size_t)(half_count > 0? half_count : 1));
+	if (!start || !half || !edges) {
+		free(start);
+		free(half);
+		free(edges);
+		return false;
+	}
+	
+	// Count the half-edges of each vertex, then place them in order
+	for (int i = 0; i < mesh->face_count; i++) {
+		const int *v = &mesh->faces[i].a;
+		for (int j = 0; j < 3; j++) {
+			int v0 = v[j], v1 = v[(j + 1) % 3];
+			start[(v0 < v1)? v0 + 1 : v1 + 1]++;
+		}
+	}
+	for (int i = 0; i < vertex_count; i++) {
+		start[i + 1] += start[i];
+	}
+	for (int i = 0; i < mesh->face_count; i++) {
+		const int *v = &mesh->faces[i].a;
+		for (int j = 0; j < 3; j++) {
+			int v0 = v[j], v1 = v[(j + 1) % 3];
+			int k = start[(v0 < v1)? v0 : v1]++;
+			half[k * 3] = v0;
+			half[k * 3 + 1] = v1;
+			half[k * 3 + 2] = i;
+		}
+	}
+	// Placing moved each start to the start of the next bucket
+	for (int i = vertex_count; i > 0; i--) {
+		start[i] = start[i - 1];
+	}
+	start[0] = 0;
+	
+	int edge_count = 0;
+	for (int i = 0; i < vertex_count; i++) {
+		int first_edge = edge_count;
+		for (int k = start[i]; k < start[i + 1]; k++) {
+			int v0 = half[k * 3], v1 = half[k * 3 + 1], face = half[k * 3 + 2];
+			if (v0 == v1) continue;
+			int other = (v0 == i)? v1 : v0;
+			
+			// A twin with a free side shares the edge. Edges of more than two
+			// faces are listed again for the extra faces.
+			int e = first_edge;
+			while (e < edge_count && !(edges[e].face[1] < 0 && (edges[e].a == other || edges[e].b == other))) e++;
+			if (e < edge_count) {
+				edges[e].face[1] = face;
+				edges[e].coplanar = faces_coplanar(mesh, edges[e].face[0], face);
+			} else {
+				mesh_edge_t *edge = &edges[edge_count++];
+				edge->a = v0;
+				edge->b = v1;
+				edge->face[0] = face;
+				edge->face[1] = -1;
+				edge->coplanar = false;
+			}
+		}
+	}
+	free(start);
+	free(half);
+	
+	if (mesh->edges) free(mesh->edges);
+	mesh_edge_t *fit = realloc(edges, sizeof(mesh_edge_t) * (size_t)(edge_count > 0? edge_count : 1));
+	mesh->edges = fit? fit : edges;
+	mesh->edge_count = edge_count;
+	return true;
+}
+
+#pragma mark - Drawing
+
+bool reserve_projected_triangles(int count) {
+	// Grows by at least half, since clipped faces add triangles one at a time
+	if (count <= projected_triangles_len) return true;
+	int len = projected_triangles_len + projected_triangles_len / 2;
+	if (len < count) len = count;
+	triangle_t *t = realloc(projected_triangles, sizeof(triangle_t) * (size_t)len);
+	if (!t) return false;
+	projected_triangles = t;
+	projected_triangles_len = len;
+	return true;
+}
+
+bool reserve_face_visible(int count) {
+	if (count <= face_visible_len) return true;
+	uint8_t *v = realloc(face_visible, (size_t)count);
+	if (!v) return false;
+	face_visible = v;
+	face_visible_len = count;
+	return true;
+}
+
+bool reserve_vertex_visible(int count) {
+	int words = (count + 63) / 64;
+	if (words <= vertex_visible_len) return true;
+	uint64_t *v = realloc(vertex_visible, sizeof(uint64_t) * (size_t)words);
+	if (!v) return false;
+	vertex_visible = v;
+	vertex_visible_len = words;
+	return true;
+}
+
+bool reserve_vertex_buffer(int count) {
+	if (count <= vertex_buffer_len) return true;
+	// The outcodes grow first: if the vertex buffer then fails to grow, the
+	// arrays sliced from it still point into the old block and stay usable
+	uint8_t *outcode = realloc(clip_vertices.outcode, (size_t)count);
+	if (!outcode) return false;
+	clip_vertices.outcode = outcode;
+	float *b = realloc(vertex_buffer, sizeof(float) * 10 * (size_t)count);
+	if (!b) return false;
+	vertex_buffer = b;
+	
+	vertex_x = b;
+	vertex_y = b + count;
+	vertex_z = b + count * 2;
+	clip_vertices.x = b + count * 3;
+	clip_vertices.y = b + count * 4;
+	clip_vertices.z = b + count * 5;
+	clip_vertices.w = b + count * 6;
+	clip_vertices.screen_x = b + count * 7;
+	clip_vertices.screen_y = b + count * 8;
+	clip_vertices.depth = b + count * 9;
+	vertex_buffer_len = count;
+	return true;
+}
+
+void add_clipped_face(const clip_vertices_t *cv, const int index[3], int *visible_count) {
+	// Clips a face that crosses the near or far plane or the guard band, and
+	// adds the result as a fan of triangles.
+	clip_vertex_t v[CLIP_MAX_VERTICES];
+	uint8_t planes = 0;
+	for (int j = 0; j < 3; j++) {
+		int k = index[j];
+		v[j].p = (vec4_t){ cv->x[k], cv->y[k], cv->z[k], cv->w[k] };
+		v[j].edge = true;
+		v[j].original = true;
+		planes |= cv->outcode[k];
+	}
+	int n = clip_polygon(v, 3, planes);
+	if (n < 3) return;
+	if (!reserve_projected_triangles(*visible_count + n - 2)) return;
+	
+	vec3_t p[CLIP_MAX_VERTICES];
+	for (int j = 0; j < n; j++) {
+		p[j] = clip_to_screen(v[j].p);
+	}
+	for (int j = 1; j + 1 < n; j++) {
+		triangle_t *t = &projected_triangles[(*visible_count)++];
+		t->a = vec2_make(p[0].x, p[0].y);
+		t->b = vec2_make(p[j].x, p[j].y);
+		t->c = vec2_make(p[j + 1].x, p[j + 1].y);
+		t->depth[0] = p[0].z;
+		t->depth[1] = p[j].z;
+		t->depth[2] = p[j + 1].z;
+	}
+}
 
 void mesh_draw(mesh_t *mesh) {
-	// Tranformation matrix
-	mat4_t transform = mat4_identity();
-	transform = mat4_translate(transform, mesh->position);
-	transform = mat4_mul(transform, mesh->rotation);
-	transform = mat4_scale(transform, mesh->scale);
-
-	if (mesh->face_count > 0 && mesh->faces) {
-		vec3_t a3, b3, c3;
-		vec2_t a2, b2, c2;
-		vec3_t vab, vac, normal, camera_ray;
-		float dot_normal_camera;
-		const vec3_t camera_pos = get_camera_position();
+	// Tranformation matrix: scale, then rotate, then translate
+	mat34_t transform = mat34_from_quat(mesh->orientation);
+	transform = mat34_scale(transform, mesh->scale);
+	transform = mat34_pre_translate(transform, mesh->position);
+
+	if (mesh->face_count > 0 && mesh->faces && mesh->vertices) {
 		const int point_w = 3;
 		
-		// Color
-		line_color = mesh->line_color;
-		fill_color = mesh->point_color;
+		int vertex_count = mesh->vertex_count;
+		if (!reserve_projected_triangles(mesh->face_count)) return;
+		if (!reserve_vertex_buffer(vertex_count)) return;
+		if (!reserve_face_visible(mesh->face_count)) return;
+		if (mesh->line_color != 0 && !mesh->edges && !mesh_build_edges(mesh)) return;
+		memset(face_visible, 0, (size_t)mesh->face_count);
+		bool draw_points = mesh->point_color != 0 && reserve_vertex_visible(vertex_count);
+		if (draw_points) memset(vertex_visible, 0, sizeof(uint64_t) * (size_t)((vertex_count + 63) / 64));
+		int visible_count = 0;
+		
+		// Transform each vertex to clip space once, in one batch with one matrix
+		for (int i = 0; i < vertex_count; i++) {
+			vertex_x[i] = mesh->vertices[i].x;
+			vertex_y[i] = mesh->vertices[i].y;
+			vertex_z[i] = mesh->vertices[i].z;
+		}
+		mat4_t mvp = get_model_view_projection(mat4_from_mat34(transform));
+		clip_transform_points(&mvp, vertex_x, vertex_y, vertex_z, &clip_vertices, vertex_count);
+		const clip_vertices_t *cv = &clip_vertices;
 		
 		for (int i = 0; i < mesh->face_count; i++) {
 			mesh_face_t face = mesh->faces[i];
+			int ia = face.a, ib = face.b, ic = face.c;
+			uint8_t oa = cv->outcode[ia], ob = cv->outcode[ib], oc = cv->outcode[ic];
+			
+			// Skip faces entirely outside one of the clip planes
+			if ((oa & ob & oc) != 0) continue;
 			
-			a3 = vec3_mat4_mul(face.a, transform);
-			b3 = vec3_mat4_mul(face.b, transform);
-			c3 = vec3_mat4_mul(face.c, transform);
+			// Backface culling: the determinant of the x, y and w of the vertices
+			// has the sign of the projected area, even for vertices behind the camera.
+			float det = cv->x[ia] * (cv->y[ib] * cv->w[ic] - cv->w[ib] * cv->y[ic]) -
+						cv->y[ia] * (cv->x[ib] * cv->w[ic] - cv->w[ib] * cv->x[ic]) +
+						cv->w[ia] * (cv->x[ib] * cv->y[ic] - cv->y[ib] * cv->x[ic]);
+			if (!(det > 0.0f)) continue;
+			face_visible[i] = 1;
+			if (draw_points) {
+				// Vertices outside a clip plane are clipped away with their points
+				if (oa == 0) vertex_visible[ia >> 6] |= 1ULL << (ia & 63);
+				if (ob == 0) vertex_visible[ib >> 6] |= 1ULL << (ib & 63);
+				if (oc == 0) vertex_visible[ic >> 6] |= 1ULL << (ic & 63);
+			}
 			
-			// Backface culling
-			vab = vec3_sub(b3, a3);
-			vac = vec3_sub(c3, a3);
-			normal = vec3_cross(vab, vac);
-			camera_ray = vec3_sub(a3, camera_pos);
-			dot_normal_camera = vec3_dot(camera_ray, normal);
-			bool should_draw = dot_normal_camera > 0.0;
+			if ((oa | ob | oc) != 0) {
+				const int index[3] = { ia, ib, ic };
+				add_clipped_face(cv, index, &visible_count);
+				continue;
+			}
 			
-			if (should_draw) {
-				// Project to 2D
-				a2 = perspective_project_point(a3);
-				b2 = perspective_project_point(b3);
-				c2 = perspective_project_point(c3);
+			triangle_t *t = &projected_triangles[visible_count++];
+			t->a = vec2_make(cv->screen_x[ia], cv->screen_y[ia]);
+			t->b = vec2_make(cv->screen_x[ib], cv->screen_y[ib]);
+			t->c = vec2_make(cv->screen_x[ic], cv->screen_y[ic]);
+			t->depth[0] = cv->depth[ia];
+			t->depth[1] = cv->depth[ib];
+			t->depth[2] = cv->depth[ic];
+		}
+		
+		// Draw faces, then lines, then points, so that lines are not covered by
+		// the faces next to them.
+		if (mesh->fill_color != 0) {
+			fill_color = mesh->fill_color;
+			for (int i = 0; i < visible_count; i++) {
+				triangle_t t = projected_triangles[i];
+				vec3_t a = { t.a.x, t.a.y, t.depth[0] };
+				vec3_t b = { t.b.x, t.b.y, t.depth[1] };
+				vec3_t c = { t.c.x, t.c.y, t.depth[2] };
+				fill_triangle_depth(a, b, c);
+			}
+		}
+		
+		if (mesh->line_color != 0) {
+			// Each edge is drawn once if either of its faces is visible
+			line_color = mesh->line_color;
+			for (int i = 0; i < mesh->edge_count; i++) {
+				mesh_edge_t e = mesh->edges[i];
+				if (e.coplanar && mesh->hide_coplanar_edges) continue;
+				if (!face_visible[e.face[0]] && !(e.face[1] >= 0 && face_visible[e.face[1]])) continue;
 				
-				// Lines
-				if (mesh->line_color != 0) {
-					move_to(a2);
-					line_to(b2);
-					line_to(c2);
-					line_to(a2);
+				uint8_t planes = cv->outcode[e.a] | cv->outcode[e.b];
+				if (planes == 0) {
+					move_to(vec2_make(cv->screen_x[e.a], cv->screen_y[e.a]));
+					line_to(vec2_make(cv->screen_x[e.b], cv->screen_y[e.b]));
+					continue;
 				}
-				
-				// Points
-				if (mesh->point_color != 0) {
-					fill_centered_rect((int)a2.x, (int)a2.y, point_w, point_w);
-					fill_centered_rect((int)b2.x, (int)b2.y, point_w, point_w);
-					fill_centered_rect((int)c2.x, (int)c2.y, point_w, point_w);
+				vec4_t a = { cv->x[e.a], cv->y[e.a], cv->z[e.a], cv->w[e.a] };
+				vec4_t b = { cv->x[e.b], cv->y[e.b], cv->z[e.b], cv->w[e.b] };
+				if (clip_segment(&a, &b, planes)) {
+					vec3_t pa = clip_to_screen(a), pb = clip_to_screen(b);
+					move_to(vec2_make(pa.x, pa.y));
+					line_to(vec2_make(pb.x, pb.y));
+				}
+			}
+		}
+		
+		if (draw_points) {
+			fill_color = mesh->point_color;
+			int words = (vertex_count + 63) / 64;
+			for (int w = 0; w < words; w++) {
+				uint64_t bits = vertex_visible[w];
+				while (bits != 0) {
+					int k = w * 64 + __builtin_ctzll(bits);
+					bits &= bits - 1;
+					fill_centered_rect(pixel_from_coord(cv->screen_x[k]), pixel_from_coord(cv->screen_y[k]), point_w, point_w);
 				}
 			}
 		}
@@ -10,30 +10,50 @@
 
 #include "color.h"
 #include "matrix.h"
+#include "quaternion.h"
 #include "vector.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Face (triangle): indexes into the mesh vertices
 typedef struct {
-	vec3_t a, b, c;
+	int a, b, c;
 } mesh_face_t;
 
+// Edge: two vertexes and the faces on either side. face[1] is -1 if only
+// one face uses the edge.
+typedef struct {
+	int a, b;
+	int face[2];
+	bool coplanar; // Both faces lie in one plane, like the diagonal of a quad
+} mesh_edge_t;
+
 // Properties
 typedef struct {
-	// Geometry
+	// Geometry: faces share vertices, so each vertex is transformed once per draw
+	int vertex_count;
+	vec3_t *vertices;
 	int face_count;
 	mesh_face_t *faces;
+	void *mapping; // Set when the arrays point into a mapped .meshbin file
+	size_t mapping_size;
+	int edge_count; // Unique edges with their faces, from mesh_build_edges()
+	mesh_edge_t *edges;
 	
-	// Visuals
+	// Visuals: a color of 0 turns that part off
+	color_abgr_t fill_color;
 	color_abgr_t line_color;
 	color_abgr_t point_color;
+	bool hide_coplanar_edges; // Leave out the edges inside flat polygons
 
 	// Physics
-	mat4_t rotation;
+	quat_t orientation;
 	vec3_t scale;
 	vec3_t position; // meters
 	vec3_t linear_momentum; // meters/second
-	vec3_t angular_momentum; // degrees/second
+	vec3_t angular_momentum; // degrees/second, about the mesh's own axes
 	double lifetime;
 } mesh_t;
 
@@ -41,8 +61,10 @@ typedef struct {
 // Functions
 mesh_t *mesh_new_cube(void);
 
-mesh_t *mesh_new(int faces);
+mesh_t *mesh_new(int vertices, int faces);
 void mesh_destroy(mesh_t *mesh);
+void mesh_normalize(mesh_t *mesh);
+bool mesh_build_edges(mesh_t *mesh);
 void mesh_update(mesh_t *mesh, double delta_time);
 void mesh_draw(mesh_t *mesh);
 
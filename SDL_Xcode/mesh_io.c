@@ -0,0 +1,772 @@
+//
+//  mesh_io.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/14/24.
+//
+
+#include "mesh_io.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A file mapped into memory, or read into a buffer where mapping fails
+typedef struct {
+	const char *data;
+	size_t size;
+	bool mapped;
+} mapped_file_t;
+
+// Vertices and faces as they are parsed. The arrays grow by doubling.
+typedef struct {
+	vec3_t *vertices;
+	int vertex_count;
+	int vertex_capacity;
+	mesh_face_t *faces;
+	int face_count;
+	int face_capacity;
+} mesh_builder_t;
+
+// Exact powers of ten for the float parser
+const double pow10_table[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+#pragma mark - Files
+
+bool map_file(const char *path, mapped_file_t *file) {
+	file->data = NULL;
+	file->size = 0;
+	file->mapped = false;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open(%s) failed!\n", path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "fstat(%s) failed!\n", path);
+		close(fd);
+		return false;
+	}
+	file->size = (size_t)st.st_size;
+	if (file->size == 0) {
+		close(fd);
+		return true;
+	}
+
+	void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+		madvise(data, file->size, MADV_SEQUENTIAL);
+#endif
+		file->data = data;
+		file->mapped = true;
+		close(fd);
+		return true;
+	}
+
+	// Some file systems cannot be mapped
+	char *buffer = malloc(file->size);
+	size_t done = 0;
+	while (buffer && done < file->size) {
+		ssize_t n = read(fd, buffer + done, file->size - done);
+		if (n <= 0) {
+			free(buffer);
+			buffer = NULL;
+			break;
+		}
+		done += (size_t)n;
+	}
+	close(fd);
+	if (!buffer) {
+		fprintf(stderr, "read(%s) failed!\n", path);
+		return false;
+	}
+	file->data = buffer;
+	return true;
+}
+
+void unmap_file(mapped_file_t *file) {
+	if (file->mapped) {
+		munmap((void *)file->data, file->size);
+	} else {
+		free((void *)file->data);
+	}
+	file->data = NULL;
+	file->size = 0;
+}
+
+#pragma mark - Mesh Builder
+
+bool builder_add_vertex(mesh_builder_t *b, float x, float y, float z) {
+	if (b->vertex_count == b->vertex_capacity) {
+		int capacity = (b->vertex_capacity > 0)? b->vertex_capacity * 2 : 1024;
+		vec3_t *v = realloc(b->vertices, sizeof(vec3_t) * (size_t)capacity);
+		if (!v) return false;
+		b->vertices = v;
+		b->vertex_capacity = capacity;
+	}
+	// Right-handed to left-handed
+	b->vertices[b->vertex_count++] = vec3_make(x, y, -z);
+	return true;
+}
+
+bool builder_add_face(mesh_builder_t *b, int i0, int i1, int i2) {
+	if (b->face_count == b->face_capacity) {
+		int capacity = (b->face_capacity > 0)? b->face_capacity * 2 : 1024;
+		mesh_face_t *f = realloc(b->faces, sizeof(mesh_face_t) * (size_t)capacity);
+		if (!f) return false;
+		b->faces = f;
+		b->face_capacity = capacity;
+	}
+	mesh_face_t *face = &b->faces[b->face_count++];
+	face->a = i0;
+	face->b = i1;
+	face->c = i2;
+	return true;
+}
+
+void builder_free(mesh_builder_t *b) {
+	free(b->vertices);
+	free(b->faces);
+	memset(b, 0, sizeof(*b));
+}
+
+mesh_t *builder_finish(mesh_builder_t *b, const char *path) {
+	// Checks the indexes and hands the arrays over to a new mesh
+	if (b->face_count == 0) {
+		fprintf(stderr, "%s: no faces\n", path);
+		builder_free(b);
+		return NULL;
+	}
+	for (int i = 0; i < b->face_count; i++) {
+		mesh_face_t f = b->faces[i];
+		if (f.a < 0 || f.a >= b->vertex_count || f.b < 0 || f.b >= b->vertex_count || f.c < 0 || f.c >= b->vertex_count) {
+			fprintf(stderr, "%s: face %d uses a vertex that does not exist\n", path, i + 1);
+			builder_free(b);
+			return NULL;
+		}
+	}
+
+	mesh_t *mesh = mesh_new(0, 0);
+	if (!mesh) {
+		builder_free(b);
+		return NULL;
+	}
+	// Give back the unused capacity
+	vec3_t *v = realloc(b->vertices, sizeof(vec3_t) * (size_t)b->vertex_count);
+	mesh_face_t *f = realloc(b->faces, sizeof(mesh_face_t) * (size_t)b->face_count);
+	mesh->vertices = v? v : b->vertices;
+	mesh->vertex_count = b->vertex_count;
+	mesh->faces = f? f : b->faces;
+	mesh->face_count = b->face_count;
+	return mesh;
+}
+
+#pragma mark - Text Parsing
+
+const char *skip_spaces(const char *p, const char *end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	return p;
+}
+
+const char *skip_line(const char *p, const char *end) {
+	const char *nl = memchr(p, '\n', (size_t)(end - p));
+	return nl? nl + 1 : end;
+}
+
+const char *parse_float(const char *p, const char *end, float *out) {
+	// Decimal number with an optional sign, fraction and exponent. Returns the
+	// end of the number, or NULL if there is none or it does not fit in a
+	// float. The digits are collected into an integer and scaled once, which
+	// is exact for up to 15 digits.
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	bool any_digits = false;
+	while (p < end && (unsigned)(*p - '0') < 10) {
+		if (mantissa < 100000000000000000ULL) {
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+		} else {
+			exponent++;
+		}
+		any_digits = true;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && (unsigned)(*p - '0') < 10) {
+			if (mantissa < 100000000000000000ULL) {
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				exponent--;
+			}
+			any_digits = true;
+			p++;
+		}
+	}
+	if (!any_digits) return NULL;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool exp_negative = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			exp_negative = *q == '-';
+			q++;
+		}
+		if (q < end && (unsigned)(*q - '0') < 10) {
+			int e = 0;
+			while (q < end && (unsigned)(*q - '0') < 10) {
+				if (e < 10000) e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += exp_negative? -e : e;
+			p = q;
+		}
+	}
+
+	double value = (double)mantissa;
+	if (mantissa == 0) {
+		value = 0.0;
+	} else if (exponent >= 0 && exponent <= 22) {
+		value *= pow10_table[exponent];
+	} else if (exponent < 0 && exponent >= -22) {
+		value /= pow10_table[-exponent];
+	} else {
+		value *= pow(10.0, exponent);
+	}
+	float f = (float)(negative? -value : value);
+	if (!isfinite(f)) return NULL;
+	*out = f;
+	return p;
+}
+
+const char *parse_int(const char *p, const char *end, long *out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if (p == end || (unsigned)(*p - '0') >= 10) return NULL;
+	long value = 0;
+	while (p < end && (unsigned)(*p - '0') < 10) {
+		if (value < 100000000000L) value = value * 10 + (*p - '0');
+		p++;
+	}
+	*out = negative? -value : value;
+	return p;
+}
+
+#pragma mark - OBJ
+
+mesh_t *mesh_load_obj(const char *path) {
+	mapped_file_t file;
+	if (!map_file(path, &file)) return NULL;
+
+	mesh_builder_t b = { 0 };
+	const char *p = file.data;
+	const char *end = file.data + file.size;
+	int line = 0;
+	const char *error = NULL;
+
+	while (!error && p < end) {
+		line++;
+		p = skip_spaces(p, end);
+		if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			// Vertex: x y z, with an optional w that is ignored
+			float c[3];
+			p += 2;
+			for (int i = 0; i < 3 && !error; i++) {
+				p = parse_float(skip_spaces(p, end), end, &c[i]);
+				if (!p) error = "invalid vertex";
+			}
+			if (!error && !builder_add_vertex(&b, c[0], c[1], c[2])) error = "out of memory";
+		} else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			// Face: v, v/vt, v//vn or v/vt/vn for each vertex. Indexes start at 1,
+			// and negative indexes count back from the last vertex.
+			int first = -1, previous = -1, n = 0;
+			p += 2;
+			while (!error) {
+				p = skip_spaces(p, end);
+				if (p == end || *p == '\n' || *p == '#') break;
+				long index;
+				p = parse_int(p, end, &index);
+				if (!p || index == 0) {
+					error = "invalid face";
+					break;
+				}
+				long v = (index > 0)? index - 1 : b.vertex_count + index;
+				if (v < 0 || v >= b.vertex_count) {
+					error = "face uses a vertex that does not exist";
+					break;
+				}
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+				if (n == 0) {
+					first = (int)v;
+				} else if (n >= 2 && !builder_add_face(&b, first, previous, (int)v)) {
+					error = "out of memory";
+				}
+				previous = (int)v;
+				n++;
+			}
+			if (!error && n < 3) error = "face has fewer than 3 vertices";
+		}
+		if (!error) p = skip_line(p, end);
+	}
+
+	unmap_file(&file);
+	if (error) {
+		fprintf(stderr, "%s:%d: %s\n", path, line, error);
+		builder_free(&b);
+		return NULL;
+	}
+	return builder_finish(&b, path);
+}
+
+#pragma mark - PLY
+
+typedef enum {
+	PLY_NONE,
+	PLY_INT8,
+	PLY_UINT8,
+	PLY_INT16,
+	PLY_UINT16,
+	PLY_INT32,
+	PLY_UINT32,
+	PLY_FLOAT32,
+	PLY_FLOAT64
+} ply_type_t;
+
+typedef enum {
+	PLY_OTHER,
+	PLY_X,
+	PLY_Y,
+	PLY_Z,
+	PLY_VERTEX_INDICES
+} ply_role_t;
+
+typedef struct {
+	ply_type_t type;
+	ply_type_t count_type; // PLY_NONE unless the property is a list
+	ply_role_t role;
+} ply_property_t;
+
+#define PLY_MAX_ELEMENTS (16)
+#define PLY_MAX_PROPERTIES (32)
+
+typedef struct {
+	bool is_vertex;
+	bool is_face;
+	long count;
+	int property_count;
+	ply_property_t properties[PLY_MAX_PROPERTIES];
+} ply_element_t;
+
+const char *ply_type_names[] = {
+	"", "char", "uchar", "short", "ushort", "int", "uint", "float", "double"
+};
+const char *ply_type_sized_names[] = {
+	"", "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64"
+};
+const size_t ply_type_sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+
+bool word_equals(const char *p, const char *end, const char *word) {
+	size_t n = strlen(word);
+	return (size_t)(end - p) >= n && memcmp(p, word, n) == 0 &&
+		(p + n == end || p[n] == ' ' || p[n] == '\t' || p[n] == '\r' || p[n] == '\n');
+}
+
+const char *next_word(const char *p, const char *end) {
+	// Skips the current word and the spaces after it
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+	return skip_spaces(p, end);
+}
+
+ply_type_t ply_parse_type(const char *p, const char *end) {
+	for (int t = PLY_INT8; t <= PLY_FLOAT64; t++) {
+		if (word_equals(p, end, ply_type_names[t]) || word_equals(p, end, ply_type_sized_names[t])) {
+			return (ply_type_t)t;
+		}
+	}
+	return PLY_NONE;
+}
+
+double ply_read_value(const uint8_t *p, ply_type_t type, bool swap) {
+	uint8_t bytes[8];
+	size_t size = ply_type_sizes[type];
+	for (size_t i = 0; i < size; i++) {
+		bytes[i] = swap? p[size - 1 - i] : p[i];
+	}
+	switch (type) {
+	case PLY_INT8: { int8_t v; memcpy(&v, bytes, 1); return v; }
+	case PLY_UINT8: return bytes[0];
+	case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); return v; }
+	case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); return v; }
+	case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); return v; }
+	case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); return v; }
+	case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+	case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+	default: break;
+	}
+	return 0.0;
+}
+
+bool ply_read_index(const uint8_t *p, ply_type_t type, bool swap, int *out) {
+	// Indexes can be stored as any type, but must be whole numbers that fit in an int
+	double v = ply_read_value(p, type, swap);
+	if (!(v >= 0.0 && v <= (double)INT_MAX) || v != floor(v)) return false;
+	*out = (int)v;
+	return true;
+}
+
+mesh_t *mesh_load_ply(const char *path) {
+	mapped_file_t file;
+	if (!map_file(path, &file)) return NULL;
+
+	const char *p = file.data;
+	const char *end = file.data + file.size;
+	ply_element_t elements[PLY_MAX_ELEMENTS];
+	int element_count = 0;
+	bool little_endian = true;
+	const char *error = NULL;
+
+	// Header
+	if (!word_equals(p, end, "ply")) error = "not a PLY file";
+	while (!error) {
+		p = skip_line(p, end);
+		if (p == end) {
+			error = "no end_header";
+			break;
+		}
+		const char *line_end = memchr(p, '\n', (size_t)(end - p));
+		if (!line_end) line_end = end;
+		const char *w = skip_spaces(p, line_end);
+
+		if (word_equals(w, line_end, "end_header")) {
+			p = skip_line(p, end);
+			break;
+		} else if (word_equals(w, line_end, "format")) {
+			w = next_word(w, line_end);
+			if (word_equals(w, line_end, "binary_little_endian")) {
+				little_endian = true;
+			} else if (word_equals(w, line_end, "binary_big_endian")) {
+				little_endian = false;
+			} else {
+				error = "only binary PLY files are supported";
+			}
+		} else if (word_equals(w, line_end, "element")) {
+			if (element_count == PLY_MAX_ELEMENTS) {
+				error = "too many elements";
+				break;
+			}
+			ply_element_t *e = &elements[element_count++];
+			memset(e, 0, sizeof(*e));
+			w = next_word(w, line_end);
+			e->is_vertex = word_equals(w, line_end, "vertex");
+			e->is_face = word_equals(w, line_end, "face");
+			w = next_word(w, line_end);
+			if (!parse_int(w, line_end, &e->count) || e->count < 0) error = "invalid element count";
+		} else if (word_equals(w, line_end, "property")) {
+			if (element_count == 0 || elements[element_count - 1].property_count == PLY_MAX_PROPERTIES) {
+				error = "unexpected property";
+				break;
+			}
+			ply_element_t *e = &elements[element_count - 1];
+			ply_property_t *prop = &e->properties[e->property_count++];
+			prop->count_type = PLY_NONE;
+			w = next_word(w, line_end);
+			if (word_equals(w, line_end, "list")) {
+				w = next_word(w, line_end);
+				prop->count_type = ply_parse_type(w, line_end);
+				w = next_word(w, line_end);
+				if (prop->count_type == PLY_NONE || prop->count_type == PLY_FLOAT32 || prop->count_type == PLY_FLOAT64) {
+					error = "invalid list count type";
+				}
+			}
+			prop->type = ply_parse_type(w, line_end);
+			if (prop->type == PLY_NONE) error = "unknown property type";
+			w = next_word(w, line_end);
+			prop->role = PLY_OTHER;
+			if (e->is_vertex && prop->count_type == PLY_NONE) {
+				if (word_equals(w, line_end, "x")) prop->role = PLY_X;
+				if (word_equals(w, line_end, "y")) prop->role = PLY_Y;
+				if (word_equals(w, line_end, "z")) prop->role = PLY_Z;
+			} else if (e->is_face && prop->count_type != PLY_NONE &&
+					   (word_equals(w, line_end, "vertex_indices") || word_equals(w, line_end, "vertex_index"))) {
+				prop->role = PLY_VERTEX_INDICES;
+			}
+		}
+	}
+
+	// Body: elements in header order, each property in turn
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bool swap = little_endian;
+#else
+	bool swap = !little_endian;
+#endif
+	mesh_builder_t b = { 0 };
+	const uint8_t *q = (const uint8_t *)p;
+	const uint8_t *q_end = (const uint8_t *)end;
+	for (int ei = 0; ei < element_count && !error; ei++) {
+		const ply_element_t *e = &elements[ei];
+		for (long i = 0; i < e->count && !error; i++) {
+			float xyz[3] = { 0, 0, 0 };
+			for (int pi = 0; pi < e->property_count && !error; pi++) {
+				const ply_property_t *prop = &e->properties[pi];
+				size_t size = ply_type_sizes[prop->type];
+				if (prop->count_type == PLY_NONE) {
+					if ((size_t)(q_end - q) < size) {
+						error = "file is truncated";
+						break;
+					}
+					if (prop->role != PLY_OTHER) {
+						xyz[prop->role - PLY_X] = (float)ply_read_value(q, prop->type, swap);
+					}
+					q += size;
+					continue;
+				}
+
+				// List: a count, then that many values
+				size_t count_size = ply_type_sizes[prop->count_type];
+				if ((size_t)(q_end - q) < count_size) {
+					error = "file is truncated";
+					break;
+				}
+				double n = ply_read_value(q, prop->count_type, swap);
+				q += count_size;
+				if (!(n >= 0.0 && n <= (double)INT_MAX) || n != floor(n)) {
+					error = "invalid list count";
+					break;
+				}
+				if ((size_t)(q_end - q) / size < (size_t)n) {
+					error = "file is truncated";
+					break;
+				}
+				if (prop->role == PLY_VERTEX_INDICES) {
+					if (n < 3) {
+						error = "face has fewer than 3 vertices";
+						break;
+					}
+					int first, previous, v;
+					if (!ply_read_index(q, prop->type, swap, &first) ||
+						!ply_read_index(q + size, prop->type, swap, &previous)) {
+						error = "invalid vertex index";
+						break;
+					}
+					for (int k = 2; k < (int)n && !error; k++) {
+						if (!ply_read_index(q + size * (size_t)k, prop->type, swap, &v)) {
+							error = "invalid vertex index";
+						} else if (!builder_add_face(&b, first, previous, v)) {
+							error = "out of memory";
+						}
+						previous = v;
+					}
+				}
+				q += size * (size_t)n;
+			}
+			if (e->is_vertex && !error) {
+				if (!isfinite(xyz[0]) || !isfinite(xyz[1]) || !isfinite(xyz[2])) {
+					error = "invalid vertex";
+				} else if (!builder_add_vertex(&b, xyz[0], xyz[1], xyz[2])) {
+					error = "out of memory";
+				}
+			}
+		}
+	}
+
+	unmap_file(&file);
+	if (error) {
+		fprintf(stderr, "%s: %s\n", path, error);
+		builder_free(&b);
+		return NULL;
+	}
+	return builder_finish(&b, path);
+}
+
+#pragma mark - Mesh Binary
+
+#define MESHBIN_HEADER_SIZE (64)
+#define MESHBIN_ALIGN (64)
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t vertex_count;
+	uint32_t face_count;
+	uint64_t vertex_offset;
+	uint64_t face_offset;
+	uint64_t file_size;
+	uint64_t checksum;
+	uint64_t reserved;
+} meshbin_header_t;
+
+_Static_assert(sizeof(meshbin_header_t) == MESHBIN_HEADER_SIZE, "meshbin header layout");
+_Static_assert(sizeof(vec3_t) == 12 && sizeof(mesh_face_t) == 12, "mesh array layout");
+
+const char meshbin_magic[8] = "MESHBIN";
+
+uint64_t meshbin_checksum(const uint8_t *data, size_t size) {
+	// Fletcher-style sums of little-endian 32-bit words. The size is a
+	// multiple of 4 because both arrays have 12-byte elements.
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i + 4 <= size; i += 4) {
+		uint32_t w;
+		memcpy(&w, data + i, 4);
+		a += w;
+		b += a;
+	}
+	return ((uint64_t)b << 32) | a;
+}
+
+size_t meshbin_align(size_t offset) {
+	return (offset + MESHBIN_ALIGN - 1) & ~(size_t)(MESHBIN_ALIGN - 1);
+}
+
+bool host_is_little_endian(void) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return false;
+#else
+	return true;
+#endif
+}
+
+mesh_t *mesh_load_meshbin(const char *path) {
+	if (!host_is_little_endian()) {
+		fprintf(stderr, "%s: .meshbin files need a little-endian machine\n", path);
+		return NULL;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open(%s) failed!\n", path);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < MESHBIN_HEADER_SIZE) {
+		fprintf(stderr, "%s: not a .meshbin file\n", path);
+		close(fd);
+		return NULL;
+	}
+	size_t size = (size_t)st.st_size;
+	// Private and writable, so the mesh can be edited in place without
+	// touching the file. Pages are only copied when they are written.
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "mmap(%s) failed!\n", path);
+		return NULL;
+	}
+
+	const meshbin_header_t *h = data;
+	const char *error = NULL;
+	size_t vertex_bytes = (size_t)h->vertex_count * sizeof(vec3_t);
+	size_t face_bytes = (size_t)h->face_count * sizeof(mesh_face_t);
+	if (memcmp(h->magic, meshbin_magic, 8) != 0) {
+		error = "not a .meshbin file";
+	} else if (h->version != MESHBIN_VERSION || h->header_size != MESHBIN_HEADER_SIZE) {
+		error = "unsupported .meshbin version";
+	} else if (h->file_size != size || h->vertex_count > INT32_MAX || h->face_count > INT32_MAX ||
+			   h->vertex_offset != MESHBIN_HEADER_SIZE ||
+			   h->face_offset != meshbin_align(MESHBIN_HEADER_SIZE + vertex_bytes) ||
+			   h->face_offset + face_bytes != size) {
+		error = "file size does not match its header";
+	} else if (meshbin_checksum((const uint8_t *)data + MESHBIN_HEADER_SIZE, size - MESHBIN_HEADER_SIZE) != h->checksum) {
+		error = "checksum does not match";
+	}
+	if (!error) {
+		// The checksum catches damage, but not a file written with bad indexes
+		const mesh_face_t *faces = (const mesh_face_t *)((const uint8_t *)data + h->face_offset);
+		uint32_t count = h->vertex_count;
+		for (uint32_t i = 0; i < h->face_count && !error; i++) {
+			if ((uint32_t)faces[i].a >= count || (uint32_t)faces[i].b >= count || (uint32_t)faces[i].c >= count) {
+				error = "face uses a vertex that does not exist";
+			}
+		}
+	}
+	mesh_t *mesh = error? NULL : mesh_new(0, 0);
+	if (!mesh) {
+		if (error) fprintf(stderr, "%s: %s\n", path, error);
+		munmap(data, size);
+		return NULL;
+	}
+
+	mesh->vertex_count = (int)h->vertex_count;
+	mesh->vertices = (vec3_t *)((uint8_t *)data + h->vertex_offset);
+	mesh->face_count = (int)h->face_count;
+	mesh->faces = (mesh_face_t *)((uint8_t *)data + h->face_offset);
+	mesh->mapping = data;
+	mesh->mapping_size = size;
+	return mesh;
+}
+
+bool mesh_save_meshbin(const mesh_t *mesh, const char *path) {
+	if (!host_is_little_endian()) {
+		fprintf(stderr, "%s: .meshbin files need a little-endian machine\n", path);
+		return false;
+	}
+	size_t vertex_bytes = sizeof(vec3_t) * (size_t)mesh->vertex_count;
+	size_t face_bytes = sizeof(mesh_face_t) * (size_t)mesh->face_count;
+	size_t face_offset = meshbin_align(MESHBIN_HEADER_SIZE + vertex_bytes);
+	size_t size = face_offset + face_bytes;
+
+	// Build the whole file in memory so the checksum can cover the padding
+	uint8_t *data = calloc(1, size);
+	if (!data) {
+		fprintf(stderr, "%s: out of memory\n", path);
+		return false;
+	}
+	if (vertex_bytes > 0) memcpy(data + MESHBIN_HEADER_SIZE, mesh->vertices, vertex_bytes);
+	if (face_bytes > 0) memcpy(data + face_offset, mesh->faces, face_bytes);
+
+	meshbin_header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, meshbin_magic, 8);
+	h.version = MESHBIN_VERSION;
+	h.header_size = MESHBIN_HEADER_SIZE;
+	h.vertex_count = (uint32_t)mesh->vertex_count;
+	h.face_count = (uint32_t)mesh->face_count;
+	h.vertex_offset = MESHBIN_HEADER_SIZE;
+	h.face_offset = face_offset;
+	h.file_size = size;
+	h.checksum = meshbin_checksum(data + MESHBIN_HEADER_SIZE, size - MESHBIN_HEADER_SIZE);
+	memcpy(data, &h, sizeof(h));
+
+	FILE *file = fopen(path, "wb");
+	bool ok = file && fwrite(data, 1, size, file) == size;
+	if (file && fclose(file) != 0) ok = false;
+	free(data);
+	if (!ok) fprintf(stderr, "Could not write %s\n", path);
+	return ok;
+}
+
+#pragma mark -
+
+mesh_t *mesh_load(const char *path) {
+	const char *ext = strrchr(path, '.');
+	if (ext && (strcmp(ext, ".obj") == 0 || strcmp(ext, ".OBJ") == 0)) {
+		return mesh_load_obj(path);
+	}
+	if (ext && (strcmp(ext, ".ply") == 0 || strcmp(ext, ".PLY") == 0)) {
+		return mesh_load_ply(path);
+	}
+	if (ext && strcmp(ext, ".meshbin") == 0) {
+		return mesh_load_meshbin(path);
+	}
+	fprintf(stderr, "%s: unknown mesh format\n", path);
+	return NULL;
+}
@@ -0,0 +1,54 @@
+//
+//  mesh_io.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/14/24.
+//
+
+#ifndef mesh_io_h
+#define mesh_io_h
+
+#include "mesh.h"
+
+#include <stdbool.h>
+
+// Mesh loading. Files are memory-mapped and parsed in one pass, straight into
+// the vertex and face arrays of the new mesh. Polygons with more than three
+// vertices are split into triangle fans.
+//
+// OBJ and PLY are right-handed, and this renderer is left-handed, so z is
+// negated on loading. Faces that are counterclockwise from the front stay
+// counterclockwise from the front.
+//
+// The functions return NULL and print the reason to stderr on failure.
+
+// Mesh binary (.meshbin): a cache of the mesh geometry laid out exactly as in
+// memory, so loading it is one mmap with no parsing and no copies. The
+// vertex and face arrays of the loaded mesh point into the mapping, which
+// is copy-on-write, and mesh_destroy() unmaps it. All values are
+// little-endian, and both arrays start on a 64-byte boundary.
+//
+//   offset  size  field
+//   0       8     magic "MESHBIN\0"
+//   8       4     version (1)
+//   12      4     header size (64)
+//   16      4     vertex count
+//   20      4     face count
+//   24      8     vertex array offset
+//   32      8     face array offset
+//   40      8     file size
+//   48      8     checksum of everything after the header
+//   56      8     reserved, 0
+//
+// The vertices are vec3_t (3 floats) and the faces are mesh_face_t (3 int32
+// indexes). Coordinates are already left-handed.
+
+#define MESHBIN_VERSION (1)
+
+mesh_t *mesh_load(const char *path); // Chooses the format by the file extension
+mesh_t *mesh_load_obj(const char *path); // Wavefront OBJ: v and f lines
+mesh_t *mesh_load_ply(const char *path); // Binary PLY, either byte order
+mesh_t *mesh_load_meshbin(const char *path);
+bool mesh_save_meshbin(const mesh_t *mesh, const char *path);
+
+#endif /* mesh_io_h */
@@ -0,0 +1,231 @@
+//
+//  profiler.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/10/24.
+//
+
+#include "profiler.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Number of histogram buckets. Bucket i holds times below 2^i microseconds,
+// so the last bucket starts at about 0.5s.
+#define PROFILE_BUCKETS (20)
+
+typedef struct {
+	uint64_t ns[PROFILE_STAGE_COUNT];
+} profile_frame_t;
+
+// Slot in the ring buffer. The sequence number is 2 * frame + 1 while the
+// frame is being written and 2 * frame + 2 once it is complete.
+typedef struct {
+	_Atomic uint64_t sequence;
+	_Atomic uint64_t ns[PROFILE_STAGE_COUNT];
+} profile_slot_t;
+
+// Ring buffer: only the rendering thread writes frames, and readers load
+// profile_head to see how many frames have been written. No locks are taken,
+// so timing a frame never waits on a report. Instead, readers check each
+// slot's sequence number before and after copying it, and skip frames that
+// were overwritten while they read them.
+profile_slot_t profile_ring[PROFILE_HISTORY];
+_Atomic uint64_t profile_head = 0;
+
+// Frame being timed
+profile_frame_t profile_current;
+uint64_t profile_frame_start = 0;
+
+const char *profile_stage_names[PROFILE_STAGE_COUNT] = {
+	"input", "update", "clear", "draw", "tiles", "upload", "present", "frame"
+};
+
+#pragma mark - Timing
+
+uint64_t profile_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void profile_add(profile_stage_t stage, uint64_t start_time) {
+	// Stages can run more than once per frame, so times add up
+	profile_current.ns[stage] += profile_now() - start_time;
+}
+
+void profile_begin_frame(void) {
+	memset(&profile_current, 0, sizeof(profile_current));
+	profile_frame_start = profile_now();
+}
+
+void profile_end_frame(void) {
+	if (profile_frame_start == 0) return;
+	profile_add(PROFILE_FRAME, profile_frame_start);
+	profile_frame_start = 0;
+	
+	// Mark the slot as being written, write it, then publish it
+	uint64_t head = atomic_load_explicit(&profile_head, memory_order_relaxed);
+	profile_slot_t *slot = &profile_ring[head % PROFILE_HISTORY];
+	atomic_store_explicit(&slot->sequence, head * 2 + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		atomic_store_explicit(&slot->ns[s], profile_current.ns[s], memory_order_relaxed);
+	}
+	atomic_store_explicit(&slot->sequence, head * 2 + 2, memory_order_release);
+	atomic_store_explicit(&profile_head, head + 1, memory_order_release);
+}
+
+void profile_reset(void) {
+	atomic_store(&profile_head, 0);
+}
+
+#pragma mark - Reports
+
+int profile_frame_count(void) {
+	uint64_t head = atomic_load_explicit(&profile_head, memory_order_acquire);
+	return (head < PROFILE_HISTORY)? (int)head : PROFILE_HISTORY;
+}
+
+const char *profile_stage_name(profile_stage_t stage) {
+	return (stage < PROFILE_STAGE_COUNT)? profile_stage_names[stage] : "?";
+}
+
+int profile_compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+bool profile_read_frame(uint64_t frame, profile_frame_t *out) {
+	// Returns false if the slot no longer holds the frame, or was being
+	// written while it was copied
+	profile_slot_t *slot = &profile_ring[frame % PROFILE_HISTORY];
+	uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+	if (sequence != frame * 2 + 2) return false;
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		out->ns[s] = atomic_load_explicit(&slot->ns[s], memory_order_relaxed);
+	}
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == sequence;
+}
+
+int profile_copy_frames(profile_frame_t *frames) {
+	// Copies the buffered frames, oldest first. Returns the number of frames.
+	// Can run on any thread: frames overwritten during the copy are left out.
+	uint64_t head = atomic_load_explicit(&profile_head, memory_order_acquire);
+	int count = (head < PROFILE_HISTORY)? (int)head : PROFILE_HISTORY;
+	uint64_t first = head - (uint64_t)count;
+	int copied = 0;
+	for (int i = 0; i < count; i++) {
+		if (profile_read_frame(first + (uint64_t)i, &frames[copied])) copied++;
+	}
+	return copied;
+}
+
+double profile_percentile_ms(const uint64_t *sorted, int count, double p) {
+	// Nearest-rank percentile
+	int rank = (int)(p / 100.0 * (double)count + 0.999999);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+	return (double)sorted[rank - 1] / 1.0e6;
+}
+
+void profile_print_histogram(FILE *file, const profile_frame_t *frames, int count, profile_stage_t stage) {
+	// Histogram of one stage's times, in power-of-two buckets
+	int buckets[PROFILE_BUCKETS] = { 0 };
+	int max_bucket = 0;
+	for (int i = 0; i < count; i++) {
+		uint64_t us = frames[i].ns[stage] / 1000;
+		int b = 0;
+		while (b < PROFILE_BUCKETS - 1 && us >= (1ULL << b)) b++;
+		buckets[b]++;
+		if (buckets[b] > max_bucket) max_bucket = buckets[b];
+	}
+	fprintf(file, "%s time histogram:\n", profile_stage_names[stage]);
+	for (int b = 0; b < PROFILE_BUCKETS; b++) {
+		if (buckets[b] == 0) continue;
+		int bar = (int)((int64_t)buckets[b] * 40 / max_bucket);
+		if (b < PROFILE_BUCKETS - 1) {
+			fprintf(file, "  <  %9.3fms %6d ", (double)(1ULL << b) / 1000.0, buckets[b]);
+		} else {
+			fprintf(file, "  >= %9.3fms %6d ", (double)(1ULL << (b - 1)) / 1000.0, buckets[b]);
+		}
+		for (int i = 0; i < bar; i++) fputc('#', file);
+		fputc('\n', file);
+	}
+}
+
+void profile_print_report(FILE *file) {
+	profile_frame_t *frames = malloc(sizeof(profile_frame_t) * PROFILE_HISTORY);
+	uint64_t *times = malloc(sizeof(uint64_t) * PROFILE_HISTORY);
+	if (!frames || !times) {
+		free(frames);
+		free(times);
+		return;
+	}
+	int count = profile_copy_frames(frames);
+	if (count == 0) {
+		fprintf(file, "No frames timed.\n");
+		free(frames);
+		free(times);
+		return;
+	}
+	
+	fprintf(file, "Frame timing over %d frames (ms):\n", count);
+	fprintf(file, "%-8s %9s %9s %9s %9s %9s\n", "stage", "mean", "p50", "p95", "p99", "max");
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		double total = 0.0;
+		for (int i = 0; i < count; i++) {
+			times[i] = frames[i].ns[s];
+			total += (double)times[i];
+		}
+		qsort(times, (size_t)count, sizeof(uint64_t), profile_compare_u64);
+		fprintf(file, "%-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", profile_stage_names[s],
+				total / (double)count / 1.0e6,
+				profile_percentile_ms(times, count, 50.0),
+				profile_percentile_ms(times, count, 95.0),
+				profile_percentile_ms(times, count, 99.0),
+				(double)times[count - 1] / 1.0e6);
+	}
+	
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		profile_print_histogram(file, frames, count, (profile_stage_t)s);
+	}
+	
+	free(frames);
+	free(times);
+}
+
+bool profile_write_csv(const char *path) {
+	profile_frame_t *frames = malloc(sizeof(profile_frame_t) * PROFILE_HISTORY);
+	if (!frames) return false;
+	int count = profile_copy_frames(frames);
+	
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "fopen(%s) failed!\n", path);
+		free(frames);
+		return false;
+	}
+	
+	fprintf(file, "frame");
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		fprintf(file, ",%s_us", profile_stage_names[s]);
+	}
+	fputc('\n', file);
+	for (int i = 0; i < count; i++) {
+		fprintf(file, "%d", i);
+		for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+			fprintf(file, ",%.3f", (double)frames[i].ns[s] / 1000.0);
+		}
+		fputc('\n', file);
+	}
+	
+	free(frames);
+	bool ok = (ferror(file) == 0);
+	if (fclose(file) != 0) ok = false;
+	return ok;
+}
@@ -0,0 +1,44 @@
+//
+//  profiler.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/10/24.
+//
+
+#ifndef profiler_h
+#define profiler_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-stage frame timing. Each stage adds its time to the current frame, and
+// profile_end_frame() pushes the frame into a ring buffer holding the last
+// PROFILE_HISTORY frames. Reports are computed from the ring buffer.
+
+#define PROFILE_HISTORY (4096)
+
+typedef enum {
+	PROFILE_INPUT,
+	PROFILE_UPDATE,
+	PROFILE_CLEAR, // fill_screen() and clear_depth_buffer()
+	PROFILE_DRAW, // mesh_draw()
+	PROFILE_TILES, // Drawing binned tiles
+	PROFILE_UPLOAD, // Copying or unlocking the frame texture
+	PROFILE_PRESENT,
+	PROFILE_FRAME, // Whole frame, from profile_begin_frame() to profile_end_frame()
+	PROFILE_STAGE_COUNT
+} profile_stage_t;
+
+uint64_t profile_now(void); // Monotonic time in nanoseconds
+void profile_add(profile_stage_t stage, uint64_t start_time); // Adds the time since start_time
+void profile_begin_frame(void);
+void profile_end_frame(void);
+
+int profile_frame_count(void); // Frames in the ring buffer
+const char *profile_stage_name(profile_stage_t stage);
+void profile_print_report(FILE *file); // p50, p95, p99 and a histogram for each stage
+bool profile_write_csv(const char *path); // One row per frame, times in microseconds
+void profile_reset(void);
+
+#endif /* profiler_h */
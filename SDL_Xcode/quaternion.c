@@ -0,0 +1,78 @@
+//
+//  quaternion.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/11/24.
+//
+
+#include "quaternion.h"
+#include "trig.h"
+#include <math.h>
+
+quat_t quat_identity(void) {
+	quat_t q = { 0, 0, 0, 1 };
+	return q;
+}
+
+quat_t quat_from_axis_angle(vec3_t axis, float a) {
+	float s, c;
+	trig_sincos(a / 2.0f, &s, &c);
+	quat_t q = { axis.x * s, axis.y * s, axis.z * s, c };
+	return q;
+}
+
+quat_t quat_from_euler_angles(vec3_t a) {
+	quat_t q = quat_from_axis_angle(vec3_make(1, 0, 0), a.x);
+	q = quat_mul(q, quat_from_axis_angle(vec3_make(0, 0, 1), a.z));
+	q = quat_mul(q, quat_from_axis_angle(vec3_make(0, 1, 0), a.y));
+	return q;
+}
+
+quat_t quat_mul(quat_t a, quat_t b) {
+	quat_t c;
+	c.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+	c.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+	c.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+	c.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+	return c;
+}
+
+quat_t quat_normalize(quat_t q) {
+	float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	if (len == 0.0f) return quat_identity();
+	quat_t r = { q.x / len, q.y / len, q.z / len, q.w / len };
+	return r;
+}
+
+quat_t quat_integrate(quat_t q, vec3_t angular_velocity, float dt) {
+	// Rotates q about its own axes by angular_velocity * dt, as one rotation
+	// about the velocity's axis. Normalizing each step keeps q from drifting.
+	vec3_t r = vec3_mul(angular_velocity, dt);
+	float angle = vec3_length(r);
+	if (angle == 0.0f) return q;
+	quat_t step = quat_from_axis_angle(vec3_div(r, angle), angle);
+	return quat_normalize(quat_mul(q, step));
+}
+
+vec3_t quat_rotate(quat_t q, vec3_t v) {
+	// v + 2w(u x v) + 2u x (u x v), where u is the vector part of q
+	vec3_t u = { q.x, q.y, q.z };
+	vec3_t t = vec3_mul(vec3_cross(u, v), 2.0f);
+	return vec3_add(vec3_add(v, vec3_mul(t, q.w)), vec3_cross(u, t));
+}
+
+mat34_t mat34_from_quat(quat_t q) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	mat34_t m = {
+		1 - 2 * (yy + zz), 2 * (xy - wz), 2 * (xz + wy), 0,
+		2 * (xy + wz), 1 - 2 * (xx + zz), 2 * (yz - wx), 0,
+		2 * (xz - wy), 2 * (yz + wx), 1 - 2 * (xx + yy), 0
+	};
+	return m;
+}
+
+mat4_t mat4_from_quat(quat_t q) {
+	return mat4_from_mat34(mat34_from_quat(q));
+}
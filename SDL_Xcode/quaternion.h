@@ -0,0 +1,31 @@
+//
+//  quaternion.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/11/24.
+//
+
+#ifndef quaternion_h
+#define quaternion_h
+
+#include "matrix.h"
+#include "vector.h"
+
+// Unit quaternions for orientation. Rotations follow the same conventions as
+// mat4_rot_x(), mat4_rot_y() and mat4_rot_z(), and quat_mul(a, b) rotates by b,
+// then by a, like mat4_mul().
+typedef struct {
+	float x, y, z, w;
+} quat_t;
+
+quat_t quat_identity(void);
+quat_t quat_from_axis_angle(vec3_t axis, float a); // axis must be unit length
+quat_t quat_from_euler_angles(vec3_t a); // Same order as mat4_apply_euler_angles()
+quat_t quat_mul(quat_t a, quat_t b);
+quat_t quat_normalize(quat_t q);
+quat_t quat_integrate(quat_t q, vec3_t angular_velocity, float dt); // Velocity in radians/second, about the local axes
+vec3_t quat_rotate(quat_t q, vec3_t v);
+mat4_t mat4_from_quat(quat_t q);
+mat34_t mat34_from_quat(quat_t q);
+
+#endif /* quaternion_h */
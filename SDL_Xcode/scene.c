@@ -0,0 +1,196 @@
+//
+//  scene.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/16/24.
+//
+
+#include "scene.h"
+#include "trig.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Number of float arrays in the scene buffer
+#define SCENE_FLOAT_ARRAYS (16)
+
+
+#pragma mark - Integration
+
+// The arrays passed to these never overlap. Saying so with restrict lets the
+// compiler vectorize the loops.
+
+void integrate_positions(float *restrict p, const float *restrict m, float dt, int count) {
+	for (int i = 0; i < count; i++) {
+		p[i] += m[i] * dt;
+	}
+}
+
+void half_rotation_angles(const float *restrict ax, const float *restrict ay, const float *restrict az, float k, float *restrict half, int count) {
+	// Half of the angle turned in one step, from angular momentum times k
+	for (int i = 0; i < count; i++) {
+		half[i] = 0.5f * k * sqrtf(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+	}
+}
+
+void rotate_orientations(float *restrict qx, float *restrict qy, float *restrict qz, float *restrict qw,
+						 const float *restrict ax, const float *restrict ay, const float *restrict az,
+						 const float *restrict half, const float *restrict s, const float *restrict c, float k, int count) {
+	for (int i = 0; i < count; i++) {
+		// Step quaternion: the unit axis times sin(angle / 2), and cos(angle / 2).
+		// With no rotation, the sine is 0 and so is the axis.
+		float h = (half[i] > 1.0e-30f)? half[i] : 1.0e-30f;
+		float f = 0.5f * k * s[i] / h;
+		float bx = ax[i] * f, by = ay[i] * f, bz = az[i] * f, bw = c[i];
+		
+		// q * step, normalized
+		float x = qw[i] * bx + qx[i] * bw + qy[i] * bz - qz[i] * by;
+		float y = qw[i] * by - qx[i] * bz + qy[i] * bw + qz[i] * bx;
+		float z = qw[i] * bz + qx[i] * by - qy[i] * bx + qz[i] * bw;
+		float w = qw[i] * bw - qx[i] * bx - qy[i] * by - qz[i] * bz;
+		float len = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+		qx[i] = x * len;
+		qy[i] = y * len;
+		qz[i] = z * len;
+		qw[i] = w * len;
+	}
+}
+
+#pragma mark - Scene
+
+scene_t *scene_new(mesh_t *mesh, int capacity) {
+	if (capacity < 0) {
+		fprintf(stderr, "Invalid scene capacity: %d\n", capacity);
+		return NULL;
+	}
+	scene_t *scene = malloc(sizeof(scene_t));
+	if (!scene) return NULL;
+
+	size_t n = (size_t)(capacity > 0? capacity : 1);
+	scene->mesh = mesh;
+	scene->count = 0;
+	scene->capacity = capacity;
+	scene->buffer = malloc(sizeof(float) * SCENE_FLOAT_ARRAYS * n);
+	scene->lifetime = malloc(sizeof(double) * n);
+	if (!scene->buffer || !scene->lifetime) {
+		fprintf(stderr, "Could not allocate a scene of %d instances\n", capacity);
+		scene_destroy(scene);
+		return NULL;
+	}
+
+	float *b = scene->buffer;
+	scene->position_x = b;
+	scene->position_y = b + n;
+	scene->position_z = b + n * 2;
+	scene->momentum_x = b + n * 3;
+	scene->momentum_y = b + n * 4;
+	scene->momentum_z = b + n * 5;
+	scene->angular_x = b + n * 6;
+	scene->angular_y = b + n * 7;
+	scene->angular_z = b + n * 8;
+	scene->orientation_x = b + n * 9;
+	scene->orientation_y = b + n * 10;
+	scene->orientation_z = b + n * 11;
+	scene->orientation_w = b + n * 12;
+	scene->half_angle = b + n * 13;
+	scene->sin_half = b + n * 14;
+	scene->cos_half = b + n * 15;
+	return scene;
+}
+
+scene_t *scene_new_grid(mesh_t *mesh, int count) {
+	// Fills a 4 meter cube around the origin, which is in view of the camera,
+	// with count instances on a grid. The spin of each instance comes from a
+	// low-discrepancy sequence, so the same count always gives the same scene.
+	scene_t *scene = scene_new(mesh, count);
+	if (!scene) return NULL;
+
+	int side = 1;
+	while (side * side * side < count) side++;
+	float spacing = 4.0f / (float)side;
+	// The mesh is expected to fit in -1...1, like the cube
+	float size = spacing * 0.3f;
+	mesh->scale = vec3_make(size, size, size);
+
+	for (int i = 0; i < count; i++) {
+		int x = i % side, y = (i / side) % side, z = i / (side * side);
+		vec3_t p = {
+			((float)x - (float)(side - 1) * 0.5f) * spacing,
+			((float)y - (float)(side - 1) * 0.5f) * spacing,
+			((float)z - (float)(side - 1) * 0.5f) * spacing
+		};
+		float u = fmodf((float)i * 0.6180340f, 1.0f);
+		float v = fmodf((float)i * 0.7548777f, 1.0f);
+		float w = fmodf((float)i * 0.5698403f, 1.0f);
+		vec3_t spin = { 10.0f + 40.0f * u, 10.0f + 40.0f * v, 10.0f + 40.0f * w };
+		scene_add(scene, p, spin);
+	}
+	return scene;
+}
+
+void scene_destroy(scene_t *scene) {
+	if (scene->buffer) free(scene->buffer);
+	if (scene->lifetime) free(scene->lifetime);
+	free(scene);
+}
+
+int scene_add(scene_t *scene, vec3_t position, vec3_t angular_momentum) {
+	if (scene->count == scene->capacity) return -1;
+	int i = scene->count++;
+	scene->position_x[i] = position.x;
+	scene->position_y[i] = position.y;
+	scene->position_z[i] = position.z;
+	scene->momentum_x[i] = 0.0f;
+	scene->momentum_y[i] = 0.0f;
+	scene->momentum_z[i] = 0.0f;
+	scene->angular_x[i] = angular_momentum.x;
+	scene->angular_y[i] = angular_momentum.y;
+	scene->angular_z[i] = angular_momentum.z;
+	scene->orientation_x[i] = 0.0f;
+	scene->orientation_y[i] = 0.0f;
+	scene->orientation_z[i] = 0.0f;
+	scene->orientation_w[i] = 1.0f;
+	scene->lifetime[i] = 0.0;
+	return i;
+}
+
+void scene_update(scene_t *scene, double delta_time) {
+	// Steps every instance like mesh_update(), one field at a time
+	int n = scene->count;
+	float dt = (float)delta_time;
+
+	for (int i = 0; i < n; i++) {
+		scene->lifetime[i] += delta_time;
+	}
+
+	integrate_positions(scene->position_x, scene->momentum_x, dt, n);
+	integrate_positions(scene->position_y, scene->momentum_y, dt, n);
+	integrate_positions(scene->position_z, scene->momentum_z, dt, n);
+
+	// Rotation: like quat_integrate(), each orientation turns by the angular
+	// velocity times dt, as one rotation about the velocity's axis
+	float k = dt * (float)(M_PI / 180.0);
+	half_rotation_angles(scene->angular_x, scene->angular_y, scene->angular_z, k, scene->half_angle, n);
+	trig_sincos_array(scene->half_angle, scene->sin_half, scene->cos_half, n);
+	rotate_orientations(scene->orientation_x, scene->orientation_y, scene->orientation_z, scene->orientation_w,
+						scene->angular_x, scene->angular_y, scene->angular_z,
+						scene->half_angle, scene->sin_half, scene->cos_half, k, n);
+}
+
+void scene_draw(scene_t *scene) {
+	// Draws the mesh once for each instance, lending it the instance's
+	// position and orientation
+	mesh_t *mesh = scene->mesh;
+	quat_t orientation = mesh->orientation;
+	vec3_t position = mesh->position;
+
+	for (int i = 0; i < scene->count; i++) {
+		mesh->orientation = (quat_t){ scene->orientation_x[i], scene->orientation_y[i], scene->orientation_z[i], scene->orientation_w[i] };
+		mesh->position = vec3_make(scene->position_x[i], scene->position_y[i], scene->position_z[i]);
+		mesh_draw(mesh);
+	}
+
+	mesh->orientation = orientation;
+	mesh->position = position;
+}
@@ -0,0 +1,44 @@
+//
+//  scene.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/16/24.
+//
+
+#ifndef scene_h
+#define scene_h
+
+#include "mesh.h"
+
+#include <stdbool.h>
+
+// Instances of one mesh. Each instance moves and spins on its own, and all of
+// them share the geometry, scale and colors of the mesh. The physics fields
+// are kept in one array per component, so scene_update() steps every
+// instance in straight loops over the arrays, with the sines and cosines of
+// the rotation steps computed by trig_sincos_array().
+typedef struct {
+	mesh_t *mesh; // Not owned by the scene
+	int count;
+	int capacity;
+
+	// Physics. The float arrays share one allocation.
+	float *position_x, *position_y, *position_z; // meters
+	float *momentum_x, *momentum_y, *momentum_z; // meters/second
+	float *angular_x, *angular_y, *angular_z; // degrees/second
+	float *orientation_x, *orientation_y, *orientation_z, *orientation_w; // Unit quaternions
+	double *lifetime; // seconds
+
+	// Scratch for scene_update()
+	float *half_angle, *sin_half, *cos_half;
+	float *buffer;
+} scene_t;
+
+scene_t *scene_new(mesh_t *mesh, int capacity);
+scene_t *scene_new_grid(mesh_t *mesh, int count); // count instances spinning in a cube around the origin, scaling the mesh to fit
+void scene_destroy(scene_t *scene);
+int scene_add(scene_t *scene, vec3_t position, vec3_t angular_momentum); // Returns the index, or -1 if the scene is full
+void scene_update(scene_t *scene, double delta_time);
+void scene_draw(scene_t *scene);
+
+#endif /* scene_h */
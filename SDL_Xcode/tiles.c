@@ -0,0 +1,490 @@
+//
+//  tiles.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/9/24.
+//
+
+#include "tiles.h"
+#include "drawing.h"
+#include "memfill.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define TILES_NO_THREADS 1
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef enum {
+	TILE_CMD_CLEAR,
+	TILE_CMD_CLEAR_DEPTH,
+	TILE_CMD_LINE,
+	TILE_CMD_RECT,
+	TILE_CMD_TRIANGLE,
+	TILE_CMD_TRIANGLE_DEPTH,
+	TILE_CMD_LINE_FIXED,
+	TILE_CMD_TRIANGLE_FIXED,
+	TILE_CMD_TRIANGLE_FIXED_DEPTH
+} tile_command_type_t;
+
+typedef struct {
+	tile_command_type_t type;
+	color_abgr_t color;
+	union {
+		struct {
+			int x0, y0, x1, y1; // Rects use x, y, w, h
+		} line;
+		struct {
+			vec2_t a, b, c;
+			float depth[3];
+		} triangle;
+		struct {
+			point_fixed_t a, b, c; // Lines use a and b
+			float depth[3];
+		} fixed;
+	};
+} tile_command_t;
+
+typedef struct {
+	clip_rect_t rect;
+	uint32_t *commands; // Indexes into tile_commands, in drawing order
+	int command_count;
+	int command_capacity;
+} tile_t;
+
+// Screen sizes come from drawing.c
+extern int screen_w;
+extern int screen_h;
+
+// Tiles
+bool tiles_on = false;
+tile_t *tiles = NULL;
+int tile_cols = 0;
+int tile_rows = 0;
+int tile_count = 0;
+
+// Commands for the current frame
+tile_command_t *tile_commands = NULL;
+int tile_command_count = 0;
+int tile_command_capacity = 0;
+
+// Thread pool. The main thread draws tiles too, so there is one worker fewer than threads.
+int thread_count = 1;
+atomic_int next_tile;
+
+#ifndef TILES_NO_THREADS
+pthread_t *workers = NULL;
+int worker_count = 0;
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+int pool_generation = 0;
+int pool_busy = 0;
+bool pool_quit = false;
+#endif
+
+
+#pragma mark - Drawing Tiles
+
+void draw_tile(tile_t *tile) {
+	set_clip_rect(tile->rect);
+	for (int i = 0; i < tile->command_count; i++) {
+		const tile_command_t *c = &tile_commands[tile->commands[i]];
+		switch (c->type) {
+		case TILE_CMD_CLEAR:
+			clear_rect(tile->rect, c->color);
+			break;
+		case TILE_CMD_CLEAR_DEPTH:
+			clear_depth_rect(tile->rect);
+			break;
+		case TILE_CMD_LINE:
+			draw_line(c->line.x0, c->line.y0, c->line.x1, c->line.y1, c->color);
+			break;
+		case TILE_CMD_RECT:
+			draw_rect(c->line.x0, c->line.y0, c->line.x1, c->line.y1, c->color);
+			break;
+		case TILE_CMD_TRIANGLE:
+			draw_triangle(c->triangle.a, c->triangle.b, c->triangle.c, NULL, c->color);
+			break;
+		case TILE_CMD_TRIANGLE_DEPTH:
+			draw_triangle(c->triangle.a, c->triangle.b, c->triangle.c, c->triangle.depth, c->color);
+			break;
+		case TILE_CMD_LINE_FIXED:
+			draw_line_fixed(c->fixed.a, c->fixed.b, c->color);
+			break;
+		case TILE_CMD_TRIANGLE_FIXED:
+			draw_triangle_fixed(c->fixed.a, c->fixed.b, c->fixed.c, NULL, c->color);
+			break;
+		case TILE_CMD_TRIANGLE_FIXED_DEPTH:
+			draw_triangle_fixed(c->fixed.a, c->fixed.b, c->fixed.c, c->fixed.depth, c->color);
+			break;
+		}
+	}
+}
+
+void draw_tiles(void) {
+	// Takes tiles until there are none left
+	int i;
+	while ((i = atomic_fetch_add(&next_tile, 1)) < tile_count) {
+		draw_tile(&tiles[i]);
+	}
+}
+
+#ifndef TILES_NO_THREADS
+
+void *tile_worker(void *arg) {
+	(void)arg;
+	int seen_generation = 0;
+	for (;;) {
+		pthread_mutex_lock(&pool_mutex);
+		while (pool_generation == seen_generation && !pool_quit) {
+			pthread_cond_wait(&pool_start, &pool_mutex);
+		}
+		if (pool_quit) {
+			pthread_mutex_unlock(&pool_mutex);
+			return NULL;
+		}
+		seen_generation = pool_generation;
+		pthread_mutex_unlock(&pool_mutex);
+		
+		draw_tiles();
+		
+		pthread_mutex_lock(&pool_mutex);
+		pool_busy--;
+		if (pool_busy == 0) pthread_cond_signal(&pool_done);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+}
+
+#endif
+
+#pragma mark - Init
+
+bool init_tiles(int threads) {
+	destroy_tiles();
+	
+#ifdef TILES_NO_THREADS
+	threads = 1;
+#else
+	if (threads <= 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cores > 0)? (int)cores : 1;
+	}
+#endif
+	
+	tile_cols = (screen_w + TILE_SIZE - 1) / TILE_SIZE;
+	tile_rows = (screen_h + TILE_SIZE - 1) / TILE_SIZE;
+	tile_count = tile_cols * tile_rows;
+	tiles = calloc((size_t)tile_count, sizeof(tile_t));
+	if (!tiles) {
+		fprintf(stderr, "calloc() failed!\n");
+		return false;
+	}
+	for (int ty = 0; ty < tile_rows; ty++) {
+		for (int tx = 0; tx < tile_cols; tx++) {
+			clip_rect_t r;
+			r.x0 = tx * TILE_SIZE;
+			r.y0 = ty * TILE_SIZE;
+			r.x1 = (r.x0 + TILE_SIZE < screen_w)? r.x0 + TILE_SIZE : screen_w;
+			r.y1 = (r.y0 + TILE_SIZE < screen_h)? r.y0 + TILE_SIZE : screen_h;
+			tiles[ty * tile_cols + tx].rect = r;
+		}
+	}
+	
+	// Pick the SIMD kernels now, before several threads use them at once
+	memfill_current_kernel();
+	blend_color_span(NULL, 0, 0);
+	
+	thread_count = threads;
+#ifndef TILES_NO_THREADS
+	pool_quit = false;
+	pool_generation = 0;
+	worker_count = threads - 1;
+	if (worker_count > 0) {
+		workers = calloc((size_t)worker_count, sizeof(pthread_t));
+		if (!workers) {
+			worker_count = 0;
+		}
+		for (int i = 0; i < worker_count; i++) {
+			if (pthread_create(&workers[i], NULL, tile_worker, NULL) != 0) {
+				fprintf(stderr, "pthread_create() failed!\n");
+				worker_count = i;
+				break;
+			}
+		}
+		thread_count = worker_count + 1;
+	}
+#endif
+	
+	tiles_on = true;
+	return true;
+}
+
+void destroy_tiles(void) {
+	if (!tiles_on) return;
+	
+#ifndef TILES_NO_THREADS
+	pthread_mutex_lock(&pool_mutex);
+	pool_quit = true;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_mutex);
+	for (int i = 0; i < worker_count; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	workers = NULL;
+	worker_count = 0;
+#endif
+	
+	for (int i = 0; i < tile_count; i++) {
+		free(tiles[i].commands);
+	}
+	free(tiles);
+	tiles = NULL;
+	tile_count = 0;
+	free(tile_commands);
+	tile_commands = NULL;
+	tile_command_count = 0;
+	tile_command_capacity = 0;
+	thread_count = 1;
+	tiles_on = false;
+}
+
+bool tiles_enabled(void) {
+	return tiles_on;
+}
+
+int tiles_thread_count(void) {
+	return thread_count;
+}
+
+#pragma mark - Binning
+
+tile_command_t *add_command(void) {
+	if (tile_command_count == tile_command_capacity) {
+		int capacity = (tile_command_capacity > 0)? tile_command_capacity * 2 : 1024;
+		tile_command_t *c = realloc(tile_commands, sizeof(tile_command_t) * (size_t)capacity);
+		if (!c) return NULL;
+		tile_commands = c;
+		tile_command_capacity = capacity;
+	}
+	return &tile_commands[tile_command_count++];
+}
+
+bool bin_command(tile_t *tile, int index) {
+	if (tile->command_count == tile->command_capacity) {
+		int capacity = (tile->command_capacity > 0)? tile->command_capacity * 2 : 64;
+		uint32_t *c = realloc(tile->commands, sizeof(uint32_t) * (size_t)capacity);
+		if (!c) return false;
+		tile->commands = c;
+		tile->command_capacity = capacity;
+	}
+	tile->commands[tile->command_count++] = (uint32_t)index;
+	return true;
+}
+
+bool bin_bounds(int index, int x0, int y0, int x1, int y1) {
+	// Adds the command to every tile that the inclusive pixel bounds touch
+	if (x1 < 0 || y1 < 0 || x0 >= screen_w || y0 >= screen_h) return true;
+	int tx0 = (x0 > 0)? x0 / TILE_SIZE : 0;
+	int ty0 = (y0 > 0)? y0 / TILE_SIZE : 0;
+	int tx1 = (x1 < screen_w)? x1 / TILE_SIZE : tile_cols - 1;
+	int ty1 = (y1 < screen_h)? y1 / TILE_SIZE : tile_rows - 1;
+	for (int ty = ty0; ty <= ty1; ty++) {
+		for (int tx = tx0; tx <= tx1; tx++) {
+			if (!bin_command(&tiles[ty * tile_cols + tx], index)) return false;
+		}
+	}
+	return true;
+}
+
+bool bin_segment(int index, double x0, double y0, double x1, double y1) {
+	// Adds a line, in pixel coordinates, to the tiles it passes through, one
+	// row of tiles at a time. Its pixels are within a pixel of the ideal line,
+	// so the part of the line in each row is widened by a pixel.
+	if (y0 > y1) {
+		double t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+	}
+	if (y1 < 0.0 || y0 >= (double)screen_h) return true;
+	double left_x = floor(fmin(x0, x1)), right_x = floor(fmax(x0, x1));
+	double slope = (y1 > y0)? (x1 - x0) / (y1 - y0) : 0.0;
+	int ty0 = (y0 > 0.0)? (int)y0 / TILE_SIZE : 0;
+	int ty1 = (y1 < (double)screen_h)? (int)y1 / TILE_SIZE : tile_rows - 1;
+	
+	for (int ty = ty0; ty <= ty1; ty++) {
+		int top = ty * TILE_SIZE;
+		double ya = fmax(y0, (double)top - 1.0);
+		double yb = fmin(y1, (double)(top + TILE_SIZE) + 1.0);
+		double xa = (y1 > y0)? x0 + (ya - y0) * slope : x0;
+		double xb = (y1 > y0)? x0 + (yb - y0) * slope : x1;
+		double left = fmax(floor(fmin(xa, xb)) - 1.0, left_x);
+		double right = fmin(floor(fmax(xa, xb)) + 1.0, right_x);
+		if (!bin_bounds(index, (int)left, top, (int)right, top)) return false;
+	}
+	return true;
+}
+
+bool bin_all(int index) {
+	for (int i = 0; i < tile_count; i++) {
+		if (!bin_command(&tiles[i], index)) return false;
+	}
+	return true;
+}
+
+bool drop_command(int index) {
+	// Called when a command could not be recorded. Takes it back out of the
+	// tiles it was added to, and draws the commands before it, so the caller
+	// can draw it directly in the right order. Always returns false.
+	if (index >= 0) {
+		for (int i = 0; i < tile_count; i++) {
+			tile_t *tile = &tiles[i];
+			if (tile->command_count > 0 && tile->commands[tile->command_count - 1] == (uint32_t)index) {
+				tile->command_count--;
+			}
+		}
+		tile_command_count = index;
+	}
+	tiles_flush();
+	return false;
+}
+
+bool tiles_add_clear(color_abgr_t color) {
+	tile_command_t *c = add_command();
+	if (!c) return drop_command(-1);
+	c->type = TILE_CMD_CLEAR;
+	c->color = color;
+	return bin_all(tile_command_count - 1) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_clear_depth(void) {
+	tile_command_t *c = add_command();
+	if (!c) return drop_command(-1);
+	c->type = TILE_CMD_CLEAR_DEPTH;
+	c->color = 0;
+	return bin_all(tile_command_count - 1) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_line(int x0, int y0, int x1, int y1, color_abgr_t color) {
+	tile_command_t *c = add_command();
+	if (!c) return drop_command(-1);
+	c->type = TILE_CMD_LINE;
+	c->color = color;
+	c->line.x0 = x0;
+	c->line.y0 = y0;
+	c->line.x1 = x1;
+	c->line.y1 = y1;
+	return bin_segment(tile_command_count - 1, x0, y0, x1, y1) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_rect(int x, int y, int w, int h, color_abgr_t color) {
+	if (w <= 0 || h <= 0) return true;
+	tile_command_t *c = add_command();
+	if (!c) return drop_command(-1);
+	c->type = TILE_CMD_RECT;
+	c->color = color;
+	c->line.x0 = x;
+	c->line.y0 = y;
+	c->line.x1 = w;
+	c->line.y1 = h;
+	return bin_bounds(tile_command_count - 1, x, y, x + w - 1, y + h - 1) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_triangle(vec2_t a, vec2_t b, vec2_t c, const float *depths, color_abgr_t color) {
+	float min_x = fminf(a.x, fminf(b.x, c.x));
+	float max_x = fmaxf(a.x, fmaxf(b.x, c.x));
+	float min_y = fminf(a.y, fminf(b.y, c.y));
+	float max_y = fmaxf(a.y, fmaxf(b.y, c.y));
+	if (!(max_x >= 0.0f && max_y >= 0.0f && min_x < (float)screen_w && min_y < (float)screen_h)) return true;
+	
+	tile_command_t *cmd = add_command();
+	if (!cmd) return drop_command(-1);
+	cmd->type = depths? TILE_CMD_TRIANGLE_DEPTH : TILE_CMD_TRIANGLE;
+	cmd->color = color;
+	cmd->triangle.a = a;
+	cmd->triangle.b = b;
+	cmd->triangle.c = c;
+	for (int i = 0; i < 3; i++) {
+		cmd->triangle.depth[i] = depths? depths[i] : 0.0f;
+	}
+	int x0 = (min_x > 0.0f)? (int)floorf(min_x) : 0;
+	int y0 = (min_y > 0.0f)? (int)floorf(min_y) : 0;
+	int x1 = (max_x < (float)screen_w)? (int)floorf(max_x) : screen_w;
+	int y1 = (max_y < (float)screen_h)? (int)floorf(max_y) : screen_h;
+	return bin_bounds(tile_command_count - 1, x0, y0, x1, y1) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_line_fixed(point_fixed_t a, point_fixed_t b, color_abgr_t color) {
+	tile_command_t *c = add_command();
+	if (!c) return drop_command(-1);
+	c->type = TILE_CMD_LINE_FIXED;
+	c->color = color;
+	c->fixed.a = a;
+	c->fixed.b = b;
+	const double scale = 1.0 / (double)(1 << SUBPIXEL_BITS);
+	return bin_segment(tile_command_count - 1, a.x * scale, a.y * scale, b.x * scale, b.y * scale) || drop_command(tile_command_count - 1);
+}
+
+bool tiles_add_triangle_fixed(point_fixed_t a, point_fixed_t b, point_fixed_t c, const float *depths, color_abgr_t color) {
+	int x0 = ((a.x < b.x)? ((a.x < c.x)? a.x : c.x) : ((b.x < c.x)? b.x : c.x)) >> SUBPIXEL_BITS;
+	int x1 = ((a.x > b.x)? ((a.x > c.x)? a.x : c.x) : ((b.x > c.x)? b.x : c.x)) >> SUBPIXEL_BITS;
+	int y0 = ((a.y < b.y)? ((a.y < c.y)? a.y : c.y) : ((b.y < c.y)? b.y : c.y)) >> SUBPIXEL_BITS;
+	int y1 = ((a.y > b.y)? ((a.y > c.y)? a.y : c.y) : ((b.y > c.y)? b.y : c.y)) >> SUBPIXEL_BITS;
+	if (x1 < 0 || y1 < 0 || x0 >= screen_w || y0 >= screen_h) return true;
+	
+	tile_command_t *cmd = add_command();
+	if (!cmd) return drop_command(-1);
+	cmd->type = depths? TILE_CMD_TRIANGLE_FIXED_DEPTH : TILE_CMD_TRIANGLE_FIXED;
+	cmd->color = color;
+	cmd->fixed.a = a;
+	cmd->fixed.b = b;
+	cmd->fixed.c = c;
+	for (int i = 0; i < 3; i++) {
+		cmd->fixed.depth[i] = depths? depths[i] : 0.0f;
+	}
+	return bin_bounds(tile_command_count - 1, x0, y0, x1, y1) || drop_command(tile_command_count - 1);
+}
+
+#pragma mark - Flush
+
+void tiles_flush(void) {
+	if (!tiles_on || tile_command_count == 0) return;
+	
+	atomic_store(&next_tile, 0);
+#ifndef TILES_NO_THREADS
+	if (worker_count > 0) {
+		pthread_mutex_lock(&pool_mutex);
+		pool_busy = worker_count;
+		pool_generation++;
+		pthread_cond_broadcast(&pool_start);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+#endif
+	
+	// The main thread draws tiles too
+	draw_tiles();
+	set_clip_rect(screen_rect());
+	
+#ifndef TILES_NO_THREADS
+	if (worker_count > 0) {
+		pthread_mutex_lock(&pool_mutex);
+		while (pool_busy > 0) {
+			pthread_cond_wait(&pool_done, &pool_mutex);
+		}
+		pthread_mutex_unlock(&pool_mutex);
+	}
+#endif
+	
+	// Start the next frame's commands
+	for (int i = 0; i < tile_count; i++) {
+		tiles[i].command_count = 0;
+	}
+	tile_command_count = 0;
+}
@@ -0,0 +1,40 @@
+//
+//  tiles.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/9/24.
+//
+
+#ifndef tiles_h
+#define tiles_h
+
+#include "color.h"
+#include "drawing.h"
+#include "vector.h"
+
+#include <stdbool.h>
+
+// Tiled renderer: while it is enabled, the drawing functions in drawing.h
+// record their primitives and bin them into screen tiles. tiles_flush() then
+// draws the tiles in parallel, each on one thread, so no pixel is shared.
+
+#define TILE_SIZE (64)
+
+bool init_tiles(int thread_count); // Call after init_screen(). 0 uses one thread per core.
+void destroy_tiles(void);
+bool tiles_enabled(void);
+int tiles_thread_count(void);
+
+// Each returns false if the command could not be recorded. The commands
+// before it have been drawn by then, so the caller should draw it directly.
+bool tiles_add_clear(color_abgr_t color);
+bool tiles_add_clear_depth(void);
+bool tiles_add_line(int x0, int y0, int x1, int y1, color_abgr_t color);
+bool tiles_add_rect(int x, int y, int w, int h, color_abgr_t color);
+bool tiles_add_triangle(vec2_t a, vec2_t b, vec2_t c, const float *depths, color_abgr_t color);
+bool tiles_add_line_fixed(point_fixed_t a, point_fixed_t b, color_abgr_t color);
+bool tiles_add_triangle_fixed(point_fixed_t a, point_fixed_t b, point_fixed_t c, const float *depths, color_abgr_t color);
+
+void tiles_flush(void);
+
+#endif /* tiles_h */
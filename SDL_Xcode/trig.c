@@ -0,0 +1,195 @@
+//
+//  trig.c
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/12/24.
+//
+
+#include "trig.h"
+
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// The angle is reduced to x in [-pi/4, pi/4] by subtracting a multiple of
+// pi/2, with pi/4 split into three parts so the subtraction stays exact.
+#define TRIG_FOUR_OVER_PI (1.27323954473516f)
+#define TRIG_PI_4_A (0.78515625f)
+#define TRIG_PI_4_B (2.4187564849853515625e-4f)
+#define TRIG_PI_4_C (3.77489497744594108e-8f)
+
+// Minimax polynomials on [-pi/4, pi/4], from the Cephes library
+#define TRIG_SIN_1 (-1.6666654611e-1f)
+#define TRIG_SIN_2 (8.3321608736e-3f)
+#define TRIG_SIN_3 (-1.9515295891e-4f)
+#define TRIG_COS_1 (4.166664568298827e-2f)
+#define TRIG_COS_2 (-1.388731625493765e-3f)
+#define TRIG_COS_3 (2.443315711809948e-5f)
+
+
+#pragma mark - Scalar
+
+void trig_sincos(float a, float *s, float *c) {
+#if defined(TRIG_FAST)
+	trig_sincos_fast(a, s, c);
+#elif defined(__APPLE__)
+	__sincosf(a, s, c);
+#elif defined(__GNUC__)
+	__builtin_sincosf(a, s, c);
+#else
+	*s = sinf(a);
+	*c = cosf(a);
+#endif
+}
+
+void trig_sincos_fast(float a, float *s, float *c) {
+	// Octant j is rounded to even, so a = j * pi/4 + x = q * pi/2 + x
+	float x = fabsf(a);
+	int j = (int)(x * TRIG_FOUR_OVER_PI);
+	j = (j + 1) & ~1;
+	float y = (float)j;
+	x = ((x - y * TRIG_PI_4_A) - y * TRIG_PI_4_B) - y * TRIG_PI_4_C;
+	int q = j >> 1;
+	
+	float z = x * x;
+	float ps = x + x * z * (TRIG_SIN_1 + z * (TRIG_SIN_2 + z * TRIG_SIN_3));
+	float pc = 1.0f - 0.5f * z + z * z * (TRIG_COS_1 + z * (TRIG_COS_2 + z * TRIG_COS_3));
+	
+	// sin(q * pi/2 + x) and cos(q * pi/2 + x) by quadrant
+	float sv = (q & 1)? pc : ps;
+	float cv = (q & 1)? ps : pc;
+	if (((q & 2) != 0) != (signbit(a) != 0)) sv = -sv;
+	if (((q + 1) & 2) != 0) cv = -cv;
+	*s = sv;
+	*c = cv;
+}
+
+#pragma mark - Batch
+
+#if defined(__SSE2__)
+
+void trig_sincos_array(const float *a, float *s, float *c, int count) {
+	// Same steps as trig_sincos_fast(), 4 angles at a time
+	const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_loadu_ps(a + i);
+		__m128 x = _mm_andnot_ps(sign_mask, v);
+		__m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(TRIG_FOUR_OVER_PI)));
+		j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+		__m128 y = _mm_cvtepi32_ps(j);
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(TRIG_PI_4_A)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(TRIG_PI_4_B)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(TRIG_PI_4_C)));
+		__m128i q = _mm_srli_epi32(j, 1);
+		
+		__m128 z = _mm_mul_ps(x, x);
+		__m128 ps = _mm_add_ps(_mm_set1_ps(TRIG_SIN_2), _mm_mul_ps(z, _mm_set1_ps(TRIG_SIN_3)));
+		ps = _mm_add_ps(_mm_set1_ps(TRIG_SIN_1), _mm_mul_ps(z, ps));
+		ps = _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, z), ps));
+		__m128 pc = _mm_add_ps(_mm_set1_ps(TRIG_COS_2), _mm_mul_ps(z, _mm_set1_ps(TRIG_COS_3)));
+		pc = _mm_add_ps(_mm_set1_ps(TRIG_COS_1), _mm_mul_ps(z, pc));
+		pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), pc));
+		
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 sv = _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+		__m128 cv = _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+		__m128 s_sign = _mm_xor_ps(_mm_castsi128_ps(_mm_slli_epi32(q, 30)), v);
+		__m128 c_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(q, _mm_set1_epi32(1)), 30));
+		_mm_storeu_ps(s + i, _mm_xor_ps(sv, _mm_and_ps(s_sign, sign_mask)));
+		_mm_storeu_ps(c + i, _mm_xor_ps(cv, _mm_and_ps(c_sign, sign_mask)));
+	}
+	for (; i < count; i++) {
+		trig_sincos_fast(a[i], s + i, c + i);
+	}
+}
+
+#elif defined(__ARM_NEON)
+
+void trig_sincos_array(const float *a, float *s, float *c, int count) {
+	const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t v = vld1q_f32(a + i);
+		float32x4_t x = vabsq_f32(v);
+		int32x4_t j = vcvtq_s32_f32(vmulq_n_f32(x, TRIG_FOUR_OVER_PI));
+		j = vandq_s32(vaddq_s32(j, vdupq_n_s32(1)), vdupq_n_s32(~1));
+		float32x4_t y = vcvtq_f32_s32(j);
+		x = vsubq_f32(x, vmulq_n_f32(y, TRIG_PI_4_A));
+		x = vsubq_f32(x, vmulq_n_f32(y, TRIG_PI_4_B));
+		x = vsubq_f32(x, vmulq_n_f32(y, TRIG_PI_4_C));
+		uint32x4_t q = vshrq_n_u32(vreinterpretq_u32_s32(j), 1);
+		
+		float32x4_t z = vmulq_f32(x, x);
+		float32x4_t ps = vaddq_f32(vdupq_n_f32(TRIG_SIN_2), vmulq_n_f32(z, TRIG_SIN_3));
+		ps = vaddq_f32(vdupq_n_f32(TRIG_SIN_1), vmulq_f32(z, ps));
+		ps = vaddq_f32(x, vmulq_f32(vmulq_f32(x, z), ps));
+		float32x4_t pc = vaddq_f32(vdupq_n_f32(TRIG_COS_2), vmulq_n_f32(z, TRIG_COS_3));
+		pc = vaddq_f32(vdupq_n_f32(TRIG_COS_1), vmulq_f32(z, pc));
+		pc = vaddq_f32(vsubq_f32(vdupq_n_f32(1.0f), vmulq_n_f32(z, 0.5f)), vmulq_f32(vmulq_f32(z, z), pc));
+		
+		uint32x4_t swap = vtstq_u32(q, vdupq_n_u32(1));
+		float32x4_t sv = vbslq_f32(swap, pc, ps);
+		float32x4_t cv = vbslq_f32(swap, ps, pc);
+		uint32x4_t s_sign = vandq_u32(veorq_u32(vshlq_n_u32(q, 30), vreinterpretq_u32_f32(v)), sign_mask);
+		uint32x4_t c_sign = vandq_u32(vshlq_n_u32(vaddq_u32(q, vdupq_n_u32(1)), 30), sign_mask);
+		vst1q_f32(s + i, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(sv), s_sign)));
+		vst1q_f32(c + i, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(cv), c_sign)));
+	}
+	for (; i < count; i++) {
+		trig_sincos_fast(a[i], s + i, c + i);
+	}
+}
+
+#elif defined(__wasm_simd128__)
+
+void trig_sincos_array(const float *a, float *s, float *c, int count) {
+	const v128_t sign_mask = wasm_i32x4_splat((int)0x80000000);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v128_t v = wasm_v128_load(a + i);
+		v128_t x = wasm_f32x4_abs(v);
+		v128_t j = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_mul(x, wasm_f32x4_splat(TRIG_FOUR_OVER_PI)));
+		j = wasm_v128_and(wasm_i32x4_add(j, wasm_i32x4_splat(1)), wasm_i32x4_splat(~1));
+		v128_t y = wasm_f32x4_convert_i32x4(j);
+		x = wasm_f32x4_sub(x, wasm_f32x4_mul(y, wasm_f32x4_splat(TRIG_PI_4_A)));
+		x = wasm_f32x4_sub(x, wasm_f32x4_mul(y, wasm_f32x4_splat(TRIG_PI_4_B)));
+		x = wasm_f32x4_sub(x, wasm_f32x4_mul(y, wasm_f32x4_splat(TRIG_PI_4_C)));
+		v128_t q = wasm_u32x4_shr(j, 1);
+		
+		v128_t z = wasm_f32x4_mul(x, x);
+		v128_t ps = wasm_f32x4_add(wasm_f32x4_splat(TRIG_SIN_2), wasm_f32x4_mul(z, wasm_f32x4_splat(TRIG_SIN_3)));
+		ps = wasm_f32x4_add(wasm_f32x4_splat(TRIG_SIN_1), wasm_f32x4_mul(z, ps));
+		ps = wasm_f32x4_add(x, wasm_f32x4_mul(wasm_f32x4_mul(x, z), ps));
+		v128_t pc = wasm_f32x4_add(wasm_f32x4_splat(TRIG_COS_2), wasm_f32x4_mul(z, wasm_f32x4_splat(TRIG_COS_3)));
+		pc = wasm_f32x4_add(wasm_f32x4_splat(TRIG_COS_1), wasm_f32x4_mul(z, pc));
+		pc = wasm_f32x4_add(wasm_f32x4_sub(wasm_f32x4_splat(1.0f), wasm_f32x4_mul(wasm_f32x4_splat(0.5f), z)), wasm_f32x4_mul(wasm_f32x4_mul(z, z), pc));
+		
+		v128_t swap = wasm_i32x4_eq(wasm_v128_and(q, wasm_i32x4_splat(1)), wasm_i32x4_splat(1));
+		v128_t sv = wasm_v128_bitselect(pc, ps, swap);
+		v128_t cv = wasm_v128_bitselect(ps, pc, swap);
+		v128_t s_sign = wasm_v128_and(wasm_v128_xor(wasm_i32x4_shl(q, 30), v), sign_mask);
+		v128_t c_sign = wasm_v128_and(wasm_i32x4_shl(wasm_i32x4_add(q, wasm_i32x4_splat(1)), 30), sign_mask);
+		wasm_v128_store(s + i, wasm_v128_xor(sv, s_sign));
+		wasm_v128_store(c + i, wasm_v128_xor(cv, c_sign));
+	}
+	for (; i < count; i++) {
+		trig_sincos_fast(a[i], s + i, c + i);
+	}
+}
+
+#else
+
+void trig_sincos_array(const float *a, float *s, float *c, int count) {
+	for (int i = 0; i < count; i++) {
+		trig_sincos_fast(a[i], s + i, c + i);
+	}
+}
+
+#endif
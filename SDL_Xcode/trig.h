@@ -0,0 +1,28 @@
+//
+//  trig.h
+//  SDL_Xcode
+//
+//  Created by Lucius Kwok on 4/12/24.
+//
+
+#ifndef trig_h
+#define trig_h
+
+// Sine and cosine of the same angle in one call.
+//
+// trig_sincos() uses the C library, which computes both from one range
+// reduction. Building with TRIG_FAST defined makes it use trig_sincos_fast()
+// instead, for every rotation builder in matrix.c, quaternion.c and vector.c.
+//
+// trig_sincos_fast() is a polynomial approximation. For |a| < 8192 its
+// absolute error is below 1e-7 (about 1 ulp near 1.0). Beyond that the
+// range reduction loses precision.
+//
+// trig_sincos_array() computes trig_sincos_fast() for many angles with SIMD,
+// and gives the same results as the scalar version.
+
+void trig_sincos(float a, float *s, float *c);
+void trig_sincos_fast(float a, float *s, float *c);
+void trig_sincos_array(const float *a, float *s, float *c, int count);
+
+#endif /* trig_h */
@@ -3,6 +3,18 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+// Building with VECMATH_INLINE defined makes the vector functions here and the
+// small matrix functions in matrix.h static inline, so the compiler can inline
+// them into their callers without LTO. Both builds compile the same source, so
+// results are identical as long as the compiler does not fuse a multiply and
+// add across two inlined calls (GCC does with FMA enabled, unless given
+// -ffp-contract=off; clang does not by default).
+#ifdef VECMATH_INLINE
+#define VECMATH_FUNC static inline
+#else
+#define VECMATH_FUNC
+#endif
+
 // Basic vector types
 
 typedef struct {
@@ -18,28 +30,32 @@ typedef struct {
 } vec4_t;
 
 // vec2 Functions
-vec2_t vec2_make(float x, float y);
-vec2_t vec2_zero(void);
-vec2_t vec2_add(vec2_t a, vec2_t b);
-vec2_t vec2_sub(vec2_t a, vec2_t b);
-vec2_t vec2_mul(vec2_t a, float b);
-vec2_t vec2_div(vec2_t a, float b);
-vec2_t vec2_rotate(vec2_t p, float a);
-float vec2_length(vec2_t v);
+VECMATH_FUNC vec2_t vec2_make(float x, float y);
+VECMATH_FUNC vec2_t vec2_zero(void);
+VECMATH_FUNC vec2_t vec2_add(vec2_t a, vec2_t b);
+VECMATH_FUNC vec2_t vec2_sub(vec2_t a, vec2_t b);
+VECMATH_FUNC vec2_t vec2_mul(vec2_t a, float b);
+VECMATH_FUNC vec2_t vec2_div(vec2_t a, float b);
+VECMATH_FUNC vec2_t vec2_rotate(vec2_t p, float a);
+VECMATH_FUNC float vec2_length(vec2_t v);
 
 // vec3 Functions
-vec3_t vec3_make(float x, float y, float z);
-vec3_t vec3_zero(void);
-vec3_t vec3_add(vec3_t a, vec3_t b);
-vec3_t vec3_sub(vec3_t a, vec3_t b);
-vec3_t vec3_mul(vec3_t a, float b);
-vec3_t vec3_div(vec3_t a, float b);
-float vec3_length(vec3_t v);
-vec3_t vec3_cross(vec3_t a, vec3_t b);
-float vec3_dot(vec3_t a, vec3_t b);
+VECMATH_FUNC vec3_t vec3_make(float x, float y, float z);
+VECMATH_FUNC vec3_t vec3_zero(void);
+VECMATH_FUNC vec3_t vec3_add(vec3_t a, vec3_t b);
+VECMATH_FUNC vec3_t vec3_sub(vec3_t a, vec3_t b);
+VECMATH_FUNC vec3_t vec3_mul(vec3_t a, float b);
+VECMATH_FUNC vec3_t vec3_div(vec3_t a, float b);
+VECMATH_FUNC float vec3_length(vec3_t v);
+VECMATH_FUNC vec3_t vec3_cross(vec3_t a, vec3_t b);
+VECMATH_FUNC float vec3_dot(vec3_t a, vec3_t b);
 
 // Conversion
-vec3_t vec4_to_vec3(vec4_t a);
-vec4_t vec3_to_vec4(vec3_t a);
+VECMATH_FUNC vec3_t vec4_to_vec3(vec4_t a);
+VECMATH_FUNC vec4_t vec3_to_vec4(vec3_t a);
+
+#ifdef VECMATH_INLINE
+#include "vector_impl.h"
+#endif
 
 #endif /* VECTOR_H */
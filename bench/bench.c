@@ -0,0 +1,458 @@
+//
+//  bench.c
+//  SDL_Xcode
+//
+//  Microbenchmarks for the software renderer kernels. Builds without SDL:
+//  cc -std=gnu17 -O2 -DHEADLESS -ISDL_Xcode bench/*.c $(ls SDL_Xcode/*.c | grep -v main.c) -lm -lpthread -o bench_run
+//
+
+#include "bench_suite.h"
+#include "matrix.h"
+#include "memfill.h"
+#include "trig.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+double get_time_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1.0e9;
+}
+
+#pragma mark - Fill
+
+void fill_reference(uint32_t *dst, uint32_t value, int count) {
+	// The original fill_screen() loop
+	for (int i = 0; i < count; i++) {
+		dst[i] = value;
+	}
+}
+
+double bench_fill(bool reference, memfill_kernel_t kernel, uint32_t *buffer, size_t count, int iterations) {
+	// Returns throughput in GB/s, or 0 if the kernel is not supported
+	if (!reference && !memfill_use_kernel(kernel)) return 0.0;
+	
+	double start = get_time_seconds();
+	for (int i = 0; i < iterations; i++) {
+		if (reference) {
+			fill_reference(buffer, (uint32_t)i, (int)count);
+		} else {
+			memfill32(buffer, (uint32_t)i, count);
+		}
+	}
+	double elapsed = get_time_seconds() - start;
+	
+	// Keep the compiler from discarding the stores
+	volatile uint32_t sink = buffer[count / 2];
+	(void)sink;
+	
+	return (double)count * sizeof(uint32_t) * iterations / elapsed / 1.0e9;
+}
+
+void run_fill_benchmarks(void) {
+	const size_t sizes[] = { 64 * 64, 320 * 240, 640 * 480, 1280 * 720, 1920 * 1080, 3840 * 2160 };
+	const memfill_kernel_t kernels[] = { MEMFILL_SCALAR, MEMFILL_SSE2, MEMFILL_AVX2, MEMFILL_NEON };
+	const int kernel_count = (int)(sizeof(kernels) / sizeof(kernels[0]));
+	
+	fprintf(stdout, "fill (GB/s)\n%12s %10s", "pixels", "reference");
+	for (int k = 0; k < kernel_count; k++) {
+		fprintf(stdout, " %10s", memfill_kernel_name(kernels[k]));
+	}
+	fprintf(stdout, "\n");
+	
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size_t count = sizes[s];
+		uint32_t *buffer = malloc(count * sizeof(uint32_t));
+		if (!buffer) return;
+		
+		// About 1 GB of stores per measurement
+		int iterations = (int)(1.0e9 / ((double)count * sizeof(uint32_t))) + 1;
+		
+		fprintf(stdout, "%12zu %10.2f", count, bench_fill(true, MEMFILL_AUTO, buffer, count, iterations));
+		for (int k = 0; k < kernel_count; k++) {
+			double gbps = bench_fill(false, kernels[k], buffer, count, iterations);
+			if (gbps > 0.0) {
+				fprintf(stdout, " %10.2f", gbps);
+			} else {
+				fprintf(stdout, " %10s", "-");
+			}
+		}
+		fprintf(stdout, "\n");
+		free(buffer);
+	}
+	memfill_use_kernel(MEMFILL_AUTO);
+}
+
+#pragma mark - Matrix
+
+// The original matrix.c loops
+mat4_t mat4_mul_reference(const mat4_t a, const mat4_t b) {
+	mat4_t c  = {0};
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			c.m[i][j] = 0;
+			for (int k = 0; k < 4; k++) {
+				c.m[i][j] += a.m[i][k] * b.m[k][j];
+			}
+		}
+	}
+	return c;
+}
+
+vec4_t vec4_mat4_mul_reference(const vec4_t v, const mat4_t m) {
+	float b[4] = { v.x, v.y, v.z, v.w };
+	float c[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			c[i] += m.m[i][j] * b[j];
+		}
+	}
+	vec4_t result = { c[0], c[1], c[2], c[3] };
+	return result;
+}
+
+mat3_t mat3_mul_reference(const mat3_t a, const mat3_t b) {
+	mat3_t c = {0};
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			c.m[i][j] = 0;
+			for (int k = 0; k < 3; k++) {
+				c.m[i][j] += a.m[i][k] * b.m[k][j];
+			}
+		}
+	}
+	return c;
+}
+
+#define MATRIX_BENCH_COUNT (256)
+
+typedef enum {
+	MATRIX_BENCH_MAT4,
+	MATRIX_BENCH_VEC4,
+	MATRIX_BENCH_MAT3
+} matrix_bench_op_t;
+
+double bench_matrix(bool reference, matrix_kernel_t kernel, matrix_bench_op_t op, int iterations) {
+	// Returns millions of operations per second, or 0 if the kernel is not supported
+	if (!reference && !matrix_use_kernel(kernel)) return 0.0;
+	
+	static mat4_t a[MATRIX_BENCH_COUNT], b[MATRIX_BENCH_COUNT];
+	static mat3_t a3[MATRIX_BENCH_COUNT], b3[MATRIX_BENCH_COUNT];
+	static vec4_t v[MATRIX_BENCH_COUNT];
+	srand(1);
+	for (int i = 0; i < MATRIX_BENCH_COUNT; i++) {
+		for (int j = 0; j < 16; j++) {
+			a[i].m[j / 4][j % 4] = (float)rand() / (float)RAND_MAX;
+			b[i].m[j / 4][j % 4] = (float)rand() / (float)RAND_MAX;
+		}
+		for (int j = 0; j < 9; j++) {
+			a3[i].m[j / 3][j % 3] = (float)rand() / (float)RAND_MAX;
+			b3[i].m[j / 3][j % 3] = (float)rand() / (float)RAND_MAX;
+		}
+		v[i] = (vec4_t){ (float)rand() / (float)RAND_MAX, (float)rand() / (float)RAND_MAX, (float)rand() / (float)RAND_MAX, 1.0f };
+	}
+	
+	float sum = 0.0f;
+	double start = get_time_seconds();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < MATRIX_BENCH_COUNT; i++) {
+			int j = (i + n) % MATRIX_BENCH_COUNT;
+			switch (op) {
+			case MATRIX_BENCH_MAT4:
+				sum += (reference? mat4_mul_reference(a[i], b[j]) : mat4_mul(a[i], b[j])).m[3][3];
+				break;
+			case MATRIX_BENCH_VEC4:
+				sum += (reference? vec4_mat4_mul_reference(v[j], a[i]) : vec4_mat4_mul(v[j], a[i])).w;
+				break;
+			case MATRIX_BENCH_MAT3:
+				sum += (reference? mat3_mul_reference(a3[i], b3[j]) : mat3_mul(a3[i], b3[j])).m[2][2];
+				break;
+			}
+		}
+	}
+	double elapsed = get_time_seconds() - start;
+	
+	// Keep the compiler from discarding the results
+	volatile float sink = sum;
+	(void)sink;
+	
+	return (double)MATRIX_BENCH_COUNT * iterations / elapsed / 1.0e6;
+}
+
+void run_matrix_benchmarks(void) {
+	const char *op_names[] = { "mat4*mat4", "mat4*vec4", "mat3*mat3" };
+	const matrix_kernel_t kernels[] = { MATRIX_SCALAR, MATRIX_SSE, MATRIX_AVX, MATRIX_NEON, MATRIX_SIMD128 };
+	const int kernel_count = (int)(sizeof(kernels) / sizeof(kernels[0]));
+	const int iterations = 40000;
+	
+	fprintf(stdout, "\nmatrix (Mops/s)\n%12s %10s", "op", "reference");
+	for (int k = 0; k < kernel_count; k++) {
+		fprintf(stdout, " %10s", matrix_kernel_name(kernels[k]));
+	}
+	fprintf(stdout, "\n");
+	
+	for (int op = MATRIX_BENCH_MAT4; op <= MATRIX_BENCH_MAT3; op++) {
+		fprintf(stdout, "%12s %10.1f", op_names[op], bench_matrix(true, MATRIX_AUTO, op, iterations));
+		for (int k = 0; k < kernel_count; k++) {
+			double mops = bench_matrix(false, kernels[k], op, iterations);
+			if (mops > 0.0) {
+				fprintf(stdout, " %10.1f", mops);
+			} else {
+				fprintf(stdout, " %10s", "-");
+			}
+		}
+		fprintf(stdout, "\n");
+	}
+	matrix_use_kernel(MATRIX_AUTO);
+}
+
+#pragma mark - Batch Transform
+
+double bench_transform(bool reference, matrix_kernel_t kernel, int count, int iterations) {
+	// Transforms and projects count points. Returns millions of points per second,
+	// or 0 if the kernel is not supported.
+	if (!reference && !matrix_use_kernel(kernel)) return 0.0;
+	
+	float *buffer = malloc(sizeof(float) * 6 * (size_t)count);
+	if (!buffer) return 0.0;
+	float *x = buffer, *y = buffer + count, *z = buffer + count * 2;
+	float *sx = buffer + count * 3, *sy = buffer + count * 4, *sz = buffer + count * 5;
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		x[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+		y[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+		z[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+	}
+	mat4_t m = mat4_translate(mat4_rot_y(mat4_identity(), 0.5f), vec3_make(0, 0, 5));
+	mat3_t view = mat3_scale(mat3_translate(mat3_identity(), vec2_make(640, 360)), vec2_make(360, 360));
+	
+	float sum = 0.0f;
+	double start = get_time_seconds();
+	for (int n = 0; n < iterations; n++) {
+		if (reference) {
+			// One point at a time, as mesh_draw() used to
+			for (int i = 0; i < count; i++) {
+				vec4_t p = vec4_mat4_mul_reference((vec4_t){ x[i], y[i], z[i], 1.0f }, m);
+				vec2_t pt2d = vec2_mat3_mul(vec2_make(p.x / p.z, p.y / p.z), view);
+				sx[i] = pt2d.x;
+				sy[i] = pt2d.y;
+			}
+		} else {
+			mat4_transform_points(&m, x, y, z, sx, sy, sz, count);
+			mat3_project_points(&view, sx, sy, sz, sx, sy, count);
+		}
+		sum += sx[n % count];
+	}
+	double elapsed = get_time_seconds() - start;
+	
+	// Keep the compiler from discarding the results
+	volatile float sink = sum;
+	(void)sink;
+	
+	free(buffer);
+	return (double)count * iterations / elapsed / 1.0e6;
+}
+
+void run_transform_benchmarks(void) {
+	const int counts[] = { 36, 1024, 100000, 1000000 };
+	const matrix_kernel_t kernels[] = { MATRIX_SCALAR, MATRIX_SSE, MATRIX_AVX, MATRIX_NEON, MATRIX_SIMD128 };
+	const int kernel_count = (int)(sizeof(kernels) / sizeof(kernels[0]));
+	
+	fprintf(stdout, "\ntransform + project (Mpoints/s)\n%12s %10s", "points", "reference");
+	for (int k = 0; k < kernel_count; k++) {
+		fprintf(stdout, " %10s", matrix_kernel_name(kernels[k]));
+	}
+	fprintf(stdout, "\n");
+	
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		// About 20 million points per measurement
+		int iterations = 20000000 / counts[c] + 1;
+		fprintf(stdout, "%12d %10.1f", counts[c], bench_transform(true, MATRIX_AUTO, counts[c], iterations));
+		for (int k = 0; k < kernel_count; k++) {
+			double mpps = bench_transform(false, kernels[k], counts[c], iterations);
+			if (mpps > 0.0) {
+				fprintf(stdout, " %10.1f", mpps);
+			} else {
+				fprintf(stdout, " %10s", "-");
+			}
+		}
+		fprintf(stdout, "\n");
+	}
+	matrix_use_kernel(MATRIX_AUTO);
+}
+
+#pragma mark - Trig
+
+typedef enum {
+	TRIG_BENCH_REFERENCE,
+	TRIG_BENCH_SINCOS,
+	TRIG_BENCH_FAST,
+	TRIG_BENCH_ARRAY,
+	TRIG_BENCH_COUNT
+} trig_bench_t;
+
+const char *trig_bench_name(trig_bench_t mode) {
+	switch (mode) {
+	case TRIG_BENCH_REFERENCE: return "sinf+cosf";
+	case TRIG_BENCH_SINCOS: return "sincos";
+	case TRIG_BENCH_FAST: return "fast";
+	case TRIG_BENCH_ARRAY: return "array";
+	default: break;
+	}
+	return "unknown";
+}
+
+double bench_trig(trig_bench_t mode, int count, int iterations) {
+	// Returns millions of angles per second
+	float *buffer = malloc(sizeof(float) * 3 * (size_t)count);
+	if (!buffer) return 0.0;
+	float *a = buffer, *s = buffer + count, *c = buffer + count * 2;
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		a[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 20.0f;
+	}
+	
+	float sum = 0.0f;
+	double start = get_time_seconds();
+	for (int n = 0; n < iterations; n++) {
+		switch (mode) {
+		case TRIG_BENCH_REFERENCE:
+			for (int i = 0; i < count; i++) {
+				s[i] = sinf(a[i]);
+				c[i] = cosf(a[i]);
+			}
+			break;
+		case TRIG_BENCH_SINCOS:
+			for (int i = 0; i < count; i++) {
+				trig_sincos(a[i], s + i, c + i);
+			}
+			break;
+		case TRIG_BENCH_FAST:
+			for (int i = 0; i < count; i++) {
+				trig_sincos_fast(a[i], s + i, c + i);
+			}
+			break;
+		default:
+			trig_sincos_array(a, s, c, count);
+			break;
+		}
+		sum += s[n % count] + c[n % count];
+	}
+	double elapsed = get_time_seconds() - start;
+	
+	// Keep the compiler from discarding the results
+	volatile float sink = sum;
+	(void)sink;
+	
+	free(buffer);
+	return (double)count * iterations / elapsed / 1.0e6;
+}
+
+void run_trig_benchmarks(void) {
+	const int counts[] = { 3, 1024, 100000 };
+	
+	fprintf(stdout, "\nsin + cos (Mangles/s)\n%12s", "angles");
+	for (int k = 0; k < TRIG_BENCH_COUNT; k++) {
+		fprintf(stdout, " %10s", trig_bench_name((trig_bench_t)k));
+	}
+	fprintf(stdout, "\n");
+	
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		// About 20 million angles per measurement
+		int iterations = 20000000 / counts[c] + 1;
+		fprintf(stdout, "%12d", counts[c]);
+		for (int k = 0; k < TRIG_BENCH_COUNT; k++) {
+			fprintf(stdout, " %10.1f", bench_trig((trig_bench_t)k, counts[c], iterations));
+		}
+		fprintf(stdout, "\n");
+	}
+}
+
+#pragma mark - Inline Vector Math
+
+#define VECMATH_WORKLOAD vecmath_workload_call
+#include "vecmath_workload.h"
+
+float vecmath_workload_inline(const vec3_t *v, int face_count, mat34_t m, vec3_t camera);
+
+double bench_vecmath(bool inline_build, const vec3_t *v, int face_count, int iterations, float *result) {
+	// Returns millions of faces per second
+	mat34_t m = mat34_pre_translate(mat34_rot_y(mat34_identity(), 0.5f), vec3_make(0, 0, 5));
+	vec3_t camera = vec3_zero();
+	
+	float sum = 0.0f;
+	double start = get_time_seconds();
+	for (int n = 0; n < iterations; n++) {
+		if (inline_build) {
+			sum += vecmath_workload_inline(v, face_count, m, camera);
+		} else {
+			sum += vecmath_workload_call(v, face_count, m, camera);
+		}
+	}
+	double elapsed = get_time_seconds() - start;
+	*result = sum;
+	return (double)face_count * iterations / elapsed / 1.0e6;
+}
+
+void run_vecmath_benchmarks(void) {
+	const int counts[] = { 12, 1024, 100000 };
+	
+	fprintf(stdout, "\nface vector math (Mfaces/s)\n%12s %10s %10s %10s\n", "faces", "call", "inline", "identical");
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		int face_count = counts[c];
+		vec3_t *v = malloc(sizeof(vec3_t) * 3 * (size_t)face_count);
+		if (!v) return;
+		srand(1);
+		for (int i = 0; i < face_count * 3; i++) {
+			v[i].x = (float)rand() / (float)RAND_MAX - 0.5f;
+			v[i].y = (float)rand() / (float)RAND_MAX - 0.5f;
+			v[i].z = (float)rand() / (float)RAND_MAX - 0.5f;
+		}
+		
+		// About 20 million faces per measurement
+		int iterations = 20000000 / face_count + 1;
+		float call_sum, inline_sum;
+		double call_mfps = bench_vecmath(false, v, face_count, iterations, &call_sum);
+		double inline_mfps = bench_vecmath(true, v, face_count, iterations, &inline_sum);
+		bool identical = memcmp(&call_sum, &inline_sum, sizeof(float)) == 0;
+		fprintf(stdout, "%12d %10.1f %10.1f %10s\n", face_count, call_mfps, inline_mfps, identical? "yes" : "no");
+		free(v);
+	}
+}
+
+#pragma mark -
+
+int main(int argc, const char * argv[]) {
+	// Options:
+	//   -suite        run only the timing suite
+	//   -json PATH    write the timing suite results to a JSON file
+	bool suite_only = false;
+	const char *json_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-suite") == 0) {
+			suite_only = true;
+		} else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: %s [-suite] [-json PATH]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	if (!suite_only) {
+		run_fill_benchmarks();
+		run_matrix_benchmarks();
+		run_transform_benchmarks();
+		run_trig_benchmarks();
+		run_vecmath_benchmarks();
+	}
+	run_suite_benchmarks();
+	if (json_path && !suite_write_json(json_path)) return 1;
+	return 0;
+}
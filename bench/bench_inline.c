@@ -0,0 +1,12 @@
+//
+//  bench_inline.c
+//  SDL_Xcode
+//
+//  The vector math workload built with VECMATH_INLINE.
+//
+
+#define VECMATH_INLINE 1
+#include "matrix.h"
+
+#define VECMATH_WORKLOAD vecmath_workload_inline
+#include "vecmath_workload.h"
@@ -0,0 +1,370 @@
+//
+//  bench_suite.c
+//  SDL_Xcode
+//
+//  Needs the headless renderer: build with HEADLESS defined.
+//
+
+#include "bench_suite.h"
+#include "color.h"
+#include "drawing.h"
+#include "matrix.h"
+#include "memfill.h"
+#include "mesh.h"
+#include "scene.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Each sample runs for about this long, after calibrating the operation count
+#define SUITE_SAMPLES (9)
+#define SUITE_SAMPLE_NS (20000000.0)
+#define SUITE_MAX_RESULTS (64)
+
+typedef void (*suite_func_t)(int64_t count); // Runs the operation count times
+
+typedef struct {
+	const char *name;
+	const char *unit; // What throughput counts
+	int size;
+	double work_per_op; // Units of throughput per operation
+	int64_t ops_per_sample;
+	double ns_mean; // Time per operation
+	double ns_stddev;
+	double ns_min;
+	double throughput; // Units per second, from the mean
+} suite_result_t;
+
+suite_result_t suite_results[SUITE_MAX_RESULTS];
+int suite_result_count = 0;
+
+// Working data for the operation being measured
+int suite_count = 0;
+mat4_t *suite_mat_a = NULL;
+mat4_t *suite_mat_b = NULL;
+vec4_t *suite_vec = NULL;
+color_abgr_t *suite_colors = NULL;
+vec2_t *suite_points = NULL;
+mesh_t *suite_mesh = NULL;
+scene_t *suite_scene = NULL;
+float suite_sink = 0.0f;
+color_abgr_t suite_color_sink = 0;
+
+#pragma mark - Measurement
+
+double suite_time_ns(suite_func_t func, int64_t count) {
+	uint64_t start = profile_now();
+	func(count);
+	return (double)(profile_now() - start);
+}
+
+void suite_measure(const char *name, const char *unit, int size, double work_per_op, suite_func_t func) {
+	if (suite_result_count == SUITE_MAX_RESULTS) return;
+	
+	// Find the operation count for one sample, which also warms up the caches
+	int64_t count = 1;
+	double ns = suite_time_ns(func, count);
+	while (ns < SUITE_SAMPLE_NS / 16.0 && count < ((int64_t)1 << 40)) {
+		count *= 2;
+		ns = suite_time_ns(func, count);
+	}
+	count = (int64_t)((double)count * SUITE_SAMPLE_NS / ns) + 1;
+	
+	double samples[SUITE_SAMPLES];
+	double sum = 0.0;
+	double min = INFINITY;
+	for (int i = 0; i < SUITE_SAMPLES; i++) {
+		samples[i] = suite_time_ns(func, count) / (double)count;
+		sum += samples[i];
+		if (samples[i] < min) min = samples[i];
+	}
+	double mean = sum / SUITE_SAMPLES;
+	double variance = 0.0;
+	for (int i = 0; i < SUITE_SAMPLES; i++) {
+		variance += (samples[i] - mean) * (samples[i] - mean);
+	}
+	variance /= SUITE_SAMPLES - 1;
+	
+	suite_result_t *r = &suite_results[suite_result_count++];
+	r->name = name;
+	r->unit = unit;
+	r->size = size;
+	r->work_per_op = work_per_op;
+	r->ops_per_sample = count;
+	r->ns_mean = mean;
+	r->ns_stddev = sqrt(variance);
+	r->ns_min = min;
+	r->throughput = work_per_op * 1.0e9 / mean;
+	fprintf(stdout, "%-14s %10d %14.2f %8.1f%% %14.2f M%s/s\n", name, size, mean,
+			100.0 * r->ns_stddev / mean, r->throughput / 1.0e6, unit);
+}
+
+#pragma mark - Operations
+
+void op_mat4_mul(int64_t count) {
+	float sum = 0.0f;
+	int i = 0;
+	for (int64_t n = 0; n < count; n++) {
+		sum += mat4_mul(suite_mat_a[i], suite_mat_b[i]).m[3][3];
+		if (++i == suite_count) i = 0;
+	}
+	suite_sink += sum;
+}
+
+void op_vec4_mat4_mul(int64_t count) {
+	const mat4_t m = suite_mat_a[0];
+	float sum = 0.0f;
+	int i = 0;
+	for (int64_t n = 0; n < count; n++) {
+		sum += vec4_mat4_mul(suite_vec[i], m).w;
+		if (++i == suite_count) i = 0;
+	}
+	suite_sink += sum;
+}
+
+void op_blend_color(int64_t count) {
+	// Blends the same source over every pixel of the buffer
+	int i = 0;
+	for (int64_t n = 0; n < count; n++) {
+		suite_colors[i] = blend_color(suite_colors[i], 0x80406080);
+		if (++i == suite_count) i = 0;
+	}
+}
+
+void op_color_from_hsv(int64_t count) {
+	color_abgr_t sum = 0;
+	double h = 0.0;
+	for (int64_t n = 0; n < count; n++) {
+		sum += color_from_hsv(h, 0.5, 0.75, 1.0);
+		h = (h < 359.0)? h + 1.0 : 0.0;
+	}
+	suite_color_sink += sum;
+}
+
+void op_fill_screen(int64_t count) {
+	for (int64_t n = 0; n < count; n++) {
+		fill_screen((color_abgr_t)n | 0xFF000000);
+	}
+}
+
+void op_line_to(int64_t count) {
+	// suite_points holds 1024 pairs of start and end points
+	line_color = ABGR_WHITE;
+	int i = 0;
+	for (int64_t n = 0; n < count; n++) {
+		move_to(suite_points[i * 2]);
+		line_to(suite_points[i * 2 + 1]);
+		if (++i == 1024) i = 0;
+	}
+}
+
+void op_fill_rect(int64_t count) {
+	// suite_points holds 1024 top left corners, and suite_count is the rect size
+	fill_color = 0xFF80C0FF;
+	int i = 0;
+	for (int64_t n = 0; n < count; n++) {
+		fill_rect((int)suite_points[i].x, (int)suite_points[i].y, suite_count, suite_count);
+		if (++i == 1024) i = 0;
+	}
+}
+
+void op_mesh_draw(int64_t count) {
+	for (int64_t n = 0; n < count; n++) {
+		mesh_update(suite_mesh, 1.0 / 60.0);
+		mesh_draw(suite_mesh);
+	}
+}
+
+void op_scene_update(int64_t count) {
+	for (int64_t n = 0; n < count; n++) {
+		scene_update(suite_scene, 1.0 / 60.0);
+	}
+}
+
+void op_scene_draw(int64_t count) {
+	for (int64_t n = 0; n < count; n++) {
+		scene_update(suite_scene, 1.0 / 60.0);
+		scene_draw(suite_scene);
+	}
+}
+
+#pragma mark - Benchmarks
+
+float suite_random(void) {
+	return (float)rand() / (float)RAND_MAX;
+}
+
+void suite_matrix(void) {
+	const int counts[] = { 64, 4096, 262144 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		suite_count = counts[c];
+		suite_mat_a = malloc(sizeof(mat4_t) * (size_t)suite_count);
+		suite_mat_b = malloc(sizeof(mat4_t) * (size_t)suite_count);
+		suite_vec = malloc(sizeof(vec4_t) * (size_t)suite_count);
+		if (suite_mat_a && suite_mat_b && suite_vec) {
+			srand(1);
+			for (int i = 0; i < suite_count; i++) {
+				for (int j = 0; j < 16; j++) {
+					suite_mat_a[i].m[j / 4][j % 4] = suite_random();
+					suite_mat_b[i].m[j / 4][j % 4] = suite_random();
+				}
+				suite_vec[i] = (vec4_t){ suite_random(), suite_random(), suite_random(), 1.0f };
+			}
+			suite_measure("mat4_mul", "mat", suite_count, 1.0, op_mat4_mul);
+			suite_measure("vec4_mat4_mul", "vec", suite_count, 1.0, op_vec4_mat4_mul);
+		}
+		free(suite_mat_a);
+		free(suite_mat_b);
+		free(suite_vec);
+		suite_mat_a = NULL;
+		suite_mat_b = NULL;
+		suite_vec = NULL;
+	}
+}
+
+void suite_color(void) {
+	const int counts[] = { 64, 4096, 1280 * 720 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		suite_count = counts[c];
+		suite_colors = malloc(sizeof(color_abgr_t) * (size_t)suite_count);
+		if (suite_colors) {
+			memfill32(suite_colors, 0xFF204060, (size_t)suite_count);
+			suite_measure("blend_color", "pixel", suite_count, 1.0, op_blend_color);
+		}
+		free(suite_colors);
+		suite_colors = NULL;
+	}
+	suite_measure("color_from_hsv", "color", 1, 1.0, op_color_from_hsv);
+}
+
+void suite_raster(void) {
+	const int sizes[][2] = { { 320, 240 }, { 1280, 720 }, { 1920, 1080 } };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		int w = sizes[s][0], h = sizes[s][1];
+		if (!init_offscreen(w, h)) return;
+		suite_measure("fill_screen", "pixel", w * h, (double)w * h, op_fill_screen);
+		
+		suite_mesh = mesh_new_cube();
+		if (suite_mesh) {
+			suite_mesh->fill_color = 0xFF808080;
+			suite_mesh->angular_momentum = vec3_make(20, 30, 10);
+			suite_measure("mesh_draw", "face", w * h, (double)suite_mesh->face_count, op_mesh_draw);
+			mesh_destroy(suite_mesh);
+			suite_mesh = NULL;
+		}
+		destroy_offscreen();
+	}
+	
+	// Lines and rects on a 1280x720 screen
+	const int w = 1280, h = 720;
+	if (!init_offscreen(w, h)) return;
+	suite_points = malloc(sizeof(vec2_t) * 2048);
+	if (suite_points) {
+		const int lengths[] = { 16, 256, 640 };
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			// 1024 lines in random directions, fully on screen. A line draws
+			// one pixel per step along its major axis, counting both ends.
+			float len = (float)lengths[l];
+			int64_t pixels = 0;
+			srand(1);
+			for (int i = 0; i < 1024; i++) {
+				float a = suite_random() * 2.0f * (float)M_PI;
+				vec2_t d = { cosf(a) * len * 0.5f, sinf(a) * len * 0.5f };
+				vec2_t c = { len * 0.5f + suite_random() * ((float)w - len), len * 0.5f + suite_random() * ((float)h - len) };
+				vec2_t p0 = vec2_sub(c, d), p1 = vec2_add(c, d);
+				suite_points[i * 2] = p0;
+				suite_points[i * 2 + 1] = p1;
+				int dx = abs((int)floorf(p1.x) - (int)floorf(p0.x));
+				int dy = abs((int)floorf(p1.y) - (int)floorf(p0.y));
+				pixels += ((dx > dy)? dx : dy) + 1;
+			}
+			suite_measure("line_to", "pixel", lengths[l], (double)pixels / 1024.0, op_line_to);
+		}
+		
+		const int rect_sizes[] = { 8, 64, 256 };
+		for (size_t r = 0; r < sizeof(rect_sizes) / sizeof(rect_sizes[0]); r++) {
+			int size = rect_sizes[r];
+			srand(1);
+			for (int i = 0; i < 1024; i++) {
+				suite_points[i] = vec2_make(floorf(suite_random() * (float)(w - size)), floorf(suite_random() * (float)(h - size)));
+			}
+			suite_count = size;
+			suite_measure("fill_rect", "pixel", size * size, (double)size * size, op_fill_rect);
+		}
+		free(suite_points);
+		suite_points = NULL;
+	}
+	destroy_offscreen();
+}
+
+void suite_scenes(void) {
+	// Spinning cubes, to see how the update and the draw scale with the
+	// number of instances
+	suite_mesh = mesh_new_cube();
+	if (!suite_mesh) return;
+	const int counts[] = { 1000, 10000, 100000 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		suite_scene = scene_new_grid(suite_mesh, counts[c]);
+		if (!suite_scene) break;
+		suite_measure("scene_update", "instance", counts[c], (double)counts[c], op_scene_update);
+		scene_destroy(suite_scene);
+	}
+	
+	const int w = 1280, h = 720;
+	if (init_offscreen(w, h)) {
+		const int draw_counts[] = { 1000, 10000 };
+		for (size_t c = 0; c < sizeof(draw_counts) / sizeof(draw_counts[0]); c++) {
+			suite_scene = scene_new_grid(suite_mesh, draw_counts[c]);
+			if (!suite_scene) break;
+			suite_measure("scene_draw", "instance", draw_counts[c], (double)draw_counts[c], op_scene_draw);
+			scene_destroy(suite_scene);
+		}
+		destroy_offscreen();
+	}
+	suite_scene = NULL;
+	mesh_destroy(suite_mesh);
+	suite_mesh = NULL;
+}
+
+#pragma mark -
+
+void run_suite_benchmarks(void) {
+	suite_result_count = 0;
+	fprintf(stdout, "\nsuite\n%-14s %10s %14s %9s %17s\n", "function", "size", "ns/op", "stddev", "throughput");
+	suite_matrix();
+	suite_color();
+	suite_raster();
+	suite_scenes();
+}
+
+bool suite_write_json(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+	fprintf(file, "{\n");
+	fprintf(file, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+#ifdef __VERSION__
+	fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+	fprintf(file, "  \"matrix_kernel\": \"%s\",\n", matrix_kernel_name(matrix_current_kernel()));
+	fprintf(file, "  \"memfill_kernel\": \"%s\",\n", memfill_kernel_name(memfill_current_kernel()));
+	fprintf(file, "  \"samples\": %d,\n", SUITE_SAMPLES);
+	fprintf(file, "  \"results\": [\n");
+	for (int i = 0; i < suite_result_count; i++) {
+		const suite_result_t *r = &suite_results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"size\": %d, \"ops_per_sample\": %lld, "
+				"\"ns_per_op\": %.3f, \"ns_stddev\": %.3f, \"ns_min\": %.3f, "
+				"\"unit\": \"%s\", \"throughput\": %.1f }%s\n",
+				r->name, r->size, (long long)r->ops_per_sample, r->ns_mean, r->ns_stddev, r->ns_min,
+				r->unit, r->throughput, (i + 1 < suite_result_count)? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,18 @@
+//
+//  bench_suite.h
+//  SDL_Xcode
+//
+//  Timing suite for the vector, matrix, color and raster functions. Each
+//  benchmark is measured in several samples, and the mean and standard
+//  deviation of the time per operation are reported.
+//
+
+#ifndef bench_suite_h
+#define bench_suite_h
+
+#include <stdbool.h>
+
+void run_suite_benchmarks(void);
+bool suite_write_json(const char *path); // Writes the results of run_suite_benchmarks()
+
+#endif /* bench_suite_h */
@@ -0,0 +1,23 @@
+//
+//  vecmath_workload.h
+//  SDL_Xcode
+//
+//  Per-face vector math for the VECMATH_INLINE benchmark. bench.c includes
+//  this with the out-of-line functions and bench_inline.c includes it with
+//  VECMATH_INLINE, so both run the same code. Define VECMATH_WORKLOAD to the
+//  function name first.
+//
+
+float VECMATH_WORKLOAD(const vec3_t *v, int face_count, mat34_t m, vec3_t camera) {
+	// Transforms each face, then sums the facing test and normal length
+	float sum = 0.0f;
+	for (int i = 0; i < face_count; i++) {
+		vec3_t a = vec3_mat34_mul(v[i * 3 + 0], m);
+		vec3_t b = vec3_mat34_mul(v[i * 3 + 1], m);
+		vec3_t c = vec3_mat34_mul(v[i * 3 + 2], m);
+		vec3_t normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+		float facing = vec3_dot(normal, vec3_sub(camera, a));
+		sum += (facing > 0.0f)? vec3_length(normal) : -facing;
+	}
+	return sum;
+}
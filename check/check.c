@@ -0,0 +1,30 @@
+//
+//  check.c
+//  SDL_Xcode
+//
+//  Correctness checks for the software renderer. Builds without SDL:
+//  cc -std=gnu17 -O2 -DHEADLESS -ISDL_Xcode check/*.c $(ls SDL_Xcode/*.c | grep -v main.c) -lm -lpthread -o check_run
+//
+
+#include "check.h"
+
+#include <stdio.h>
+
+
+int main(int argc, const char * argv[]) {
+	int failures = 0;
+
+	int n = check_blend();
+	printf("blend: %s\n", (n == 0)? "ok" : "FAILED");
+	failures += n;
+
+	n = check_mesh_io();
+	printf("mesh_io: %s\n", (n == 0)? "ok" : "FAILED");
+	failures += n;
+
+	if (failures > 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	return 0;
+}
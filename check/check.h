@@ -0,0 +1,15 @@
+//
+//  check.h
+//  SDL_Xcode
+//
+//  Checks for the renderer kernels and loaders. Each check prints the cases
+//  that fail and returns the number of failures.
+//
+
+#ifndef check_h
+#define check_h
+
+int check_blend(void);
+int check_mesh_io(void);
+
+#endif /* check_h */
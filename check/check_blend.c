@@ -0,0 +1,121 @@
+//
+//  check_blend.c
+//  SDL_Xcode
+//
+//  Compares every span and array blending kernel with blend_color(), pixel
+//  for pixel.
+//
+
+#include "check.h"
+#include "color.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_SPAN_MAX (67)
+
+typedef void (*check_span_func_t)(color_abgr_t *dst, size_t count, color_abgr_t y);
+typedef void (*check_array_func_t)(color_abgr_t *dst, const color_abgr_t *src, size_t count);
+
+color_abgr_t random_color(void) {
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+int check_span_kernel(const char *name, check_span_func_t kernel) {
+	// Spans of every length up to a few vectors, at every offset within a
+	// vector, so both the SIMD body and the scalar tail are covered
+	color_abgr_t src[CHECK_SPAN_MAX + 8], dst[CHECK_SPAN_MAX + 8];
+	int failures = 0;
+
+	srand(1);
+	for (int trial = 0; trial < 200; trial++) {
+		color_abgr_t y = random_color();
+		// Include the fully transparent and fully opaque cases
+		if (trial == 0) y &= 0x00FFFFFF;
+		if (trial == 1) y |= 0xFF000000;
+
+		for (int offset = 0; offset < 8; offset++) {
+			for (int count = 0; count <= CHECK_SPAN_MAX; count++) {
+				for (int i = 0; i < CHECK_SPAN_MAX + 8; i++) {
+					src[i] = random_color();
+					dst[i] = src[i];
+				}
+				kernel(dst + offset, (size_t)count, y);
+
+				for (int i = 0; i < CHECK_SPAN_MAX + 8; i++) {
+					bool inside = i >= offset && i < offset + count;
+					color_abgr_t expected = inside? blend_color(src[i], y) : src[i];
+					if (dst[i] != expected) {
+						if (failures < 10) {
+							fprintf(stderr, "%s: pixel %d of %d at offset %d: 0x%08X over 0x%08X gave 0x%08X, expected 0x%08X\n",
+									name, i - offset, count, offset, y, src[i], dst[i], expected);
+						}
+						failures++;
+					}
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+int check_array_kernel(const char *name, check_array_func_t kernel) {
+	// Like check_span_kernel(), with every source pixel different. The source
+	// and destination are offset separately, so their alignments differ.
+	color_abgr_t src[CHECK_SPAN_MAX + 8], old[CHECK_SPAN_MAX + 8], dst[CHECK_SPAN_MAX + 8];
+	int failures = 0;
+
+	srand(1);
+	for (int trial = 0; trial < 200; trial++) {
+		for (int offset = 0; offset < 8; offset++) {
+			int src_offset = (offset * 3 + trial) % 8;
+			for (int count = 0; count <= CHECK_SPAN_MAX; count++) {
+				for (int i = 0; i < CHECK_SPAN_MAX + 8; i++) {
+					src[i] = random_color();
+					// Include fully transparent and fully opaque pixels
+					if (i % 7 == 0) src[i] &= 0x00FFFFFF;
+					if (i % 7 == 1) src[i] |= 0xFF000000;
+					old[i] = random_color();
+					dst[i] = old[i];
+				}
+				kernel(dst + offset, src + src_offset, (size_t)count);
+
+				for (int i = 0; i < CHECK_SPAN_MAX + 8; i++) {
+					bool inside = i >= offset && i < offset + count;
+					color_abgr_t y = inside? src[i - offset + src_offset] : 0;
+					color_abgr_t expected = inside? blend_color(old[i], y) : old[i];
+					if (dst[i] != expected) {
+						if (failures < 10) {
+							fprintf(stderr, "%s: pixel %d of %d at offsets %d, %d: 0x%08X over 0x%08X gave 0x%08X, expected 0x%08X\n",
+									name, i - offset, count, offset, src_offset, y, old[i], dst[i], expected);
+						}
+						failures++;
+					}
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+int check_blend(void) {
+	int failures = 0;
+	failures += check_span_kernel("blend_color_span_scalar", blend_color_span_scalar);
+	failures += check_array_kernel("blend_color_array_scalar", blend_color_array_scalar);
+#if defined(__SSE2__)
+	failures += check_span_kernel("blend_color_span_sse2", blend_color_span_sse2);
+	failures += check_array_kernel("blend_color_array_sse2", blend_color_array_sse2);
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		failures += check_span_kernel("blend_color_span_avx2", blend_color_span_avx2);
+		failures += check_array_kernel("blend_color_array_avx2", blend_color_array_avx2);
+	}
+#elif defined(__ARM_NEON)
+	failures += check_span_kernel("blend_color_span_neon", blend_color_span_neon);
+	failures += check_array_kernel("blend_color_array_neon", blend_color_array_neon);
+#endif
+	failures += check_span_kernel("blend_color_span", blend_color_span);
+	failures += check_array_kernel("blend_color_array", blend_color_array);
+	return failures;
+}
@@ -0,0 +1,239 @@
+//
+//  check_mesh_io.c
+//  SDL_Xcode
+//
+//  Feeds the mesh loaders small valid files and malformed ones. Malformed
+//  files must be rejected with NULL, never loaded with wrapped or made-up
+//  values. The loaders' own messages on stderr are silenced.
+//
+
+#include "check.h"
+#include "mesh_io.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+char check_dir[64];
+
+const char *check_path(const char *name) {
+	static char path[128];
+	snprintf(path, sizeof(path), "%s/%s", check_dir, name);
+	return path;
+}
+
+bool write_file(const char *path, const void *data, size_t size) {
+	FILE *file = fopen(path, "wb");
+	if (!file) return false;
+	bool ok = fwrite(data, 1, size, file) == size;
+	return (fclose(file) == 0) && ok;
+}
+
+int check_load(const char *name, const void *data, size_t size, int face_count) {
+	// Loads the data as a file with the given name. A face count of -1 means
+	// the file must be rejected.
+	const char *path = check_path(name);
+	if (!write_file(path, data, size)) {
+		fprintf(stderr, "mesh_io: could not write %s\n", path);
+		return 1;
+	}
+
+	fflush(stderr);
+	int saved_stderr = dup(STDERR_FILENO);
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd >= 0) {
+		dup2(null_fd, STDERR_FILENO);
+		close(null_fd);
+	}
+	mesh_t *mesh = mesh_load(path);
+	fflush(stderr);
+	if (saved_stderr >= 0) {
+		dup2(saved_stderr, STDERR_FILENO);
+		close(saved_stderr);
+	}
+	remove(path);
+
+	int failures = 0;
+	if (face_count < 0 && mesh) {
+		fprintf(stderr, "mesh_io: %s was loaded, but should have been rejected\n", name);
+		failures++;
+	} else if (face_count >= 0 && !mesh) {
+		fprintf(stderr, "mesh_io: %s was rejected, but should have loaded\n", name);
+		failures++;
+	} else if (mesh && mesh->face_count != face_count) {
+		fprintf(stderr, "mesh_io: %s has %d faces, expected %d\n", name, mesh->face_count, face_count);
+		failures++;
+	}
+	if (mesh) mesh_destroy(mesh);
+	return failures;
+}
+
+int check_obj(const char *text, int face_count) {
+	return check_load("check.obj", text, strlen(text), face_count);
+}
+
+#pragma mark - PLY
+
+// Binary little-endian PLY with three vertices and one face, whose list
+// count and index types are given. The body is filled in by the caller.
+size_t ply_header(char *buffer, size_t size, const char *count_type, const char *index_type) {
+	int n = snprintf(buffer, size,
+					 "ply\nformat binary_little_endian 1.0\n"
+					 "element vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+					 "element face 1\nproperty list %s %s vertex_indices\nend_header\n",
+					 count_type, index_type);
+	return (n > 0)? (size_t)n : 0;
+}
+
+size_t ply_vertices(uint8_t *p, float bad) {
+	// The first coordinate is bad, the rest form a triangle
+	float v[9] = { bad, 0, 0, 1, 0, 0, 0, 1, 0 };
+	memcpy(p, v, sizeof(v));
+	return sizeof(v);
+}
+
+int check_ply_int(const char *index_type, uint32_t last_index, int face_count) {
+	uint8_t data[512];
+	size_t n = ply_header((char *)data, sizeof(data), "uchar", index_type);
+	n += ply_vertices(data + n, 0.0f);
+	data[n++] = 3;
+	uint32_t indexes[3] = { 0, 1, last_index };
+	memcpy(data + n, indexes, sizeof(indexes));
+	n += sizeof(indexes);
+	return check_load("check.ply", data, n, face_count);
+}
+
+int check_ply_float(float last_index, float vertex, int face_count) {
+	// Float indexes are allowed by the format, so they are checked for being
+	// whole numbers in range
+	uint8_t data[512];
+	size_t n = ply_header((char *)data, sizeof(data), "uchar", "float");
+	n += ply_vertices(data + n, vertex);
+	data[n++] = 3;
+	float indexes[3] = { 0, 1, last_index };
+	memcpy(data + n, indexes, sizeof(indexes));
+	n += sizeof(indexes);
+	return check_load("check.ply", data, n, face_count);
+}
+
+int check_ply_count(const char *count_type, uint32_t count, int face_count) {
+	// A list of three int indexes with the given count in front
+	uint8_t data[512];
+	size_t n = ply_header((char *)data, sizeof(data), count_type, "int");
+	n += ply_vertices(data + n, 0.0f);
+	if (strcmp(count_type, "uchar") == 0) {
+		data[n++] = (uint8_t)count;
+	} else {
+		memcpy(data + n, &count, sizeof(count));
+		n += sizeof(count);
+	}
+	int32_t indexes[3] = { 0, 1, 2 };
+	memcpy(data + n, indexes, sizeof(indexes));
+	n += sizeof(indexes);
+	return check_load("check.ply", data, n, face_count);
+}
+
+#pragma mark - Mesh Binary
+
+int check_meshbin(void) {
+	// Saves a triangle, then loads it whole, cut short and with a changed byte
+	mesh_t *mesh = mesh_new(3, 1);
+	if (!mesh) return 1;
+	mesh->vertices[0] = vec3_make(0, 0, 0);
+	mesh->vertices[1] = vec3_make(1, 0, 0);
+	mesh->vertices[2] = vec3_make(0, 1, 0);
+	mesh->faces[0] = (mesh_face_t){ 0, 1, 2 };
+
+	const char *path = check_path("saved.meshbin");
+	bool saved = mesh_save_meshbin(mesh, path);
+	mesh_destroy(mesh);
+	if (!saved) {
+		fprintf(stderr, "mesh_io: could not save %s\n", path);
+		return 1;
+	}
+
+	uint8_t data[1024];
+	FILE *file = fopen(path, "rb");
+	size_t size = file? fread(data, 1, sizeof(data), file) : 0;
+	if (file) fclose(file);
+	remove(path);
+	if (size == 0 || size == sizeof(data)) {
+		fprintf(stderr, "mesh_io: could not read back %s\n", path);
+		return 1;
+	}
+
+	int failures = 0;
+	failures += check_load("check.meshbin", data, size, 1);
+	failures += check_load("check.meshbin", data, size - 4, -1);
+	failures += check_load("check.meshbin", data, 32, -1);
+	data[size - 1] ^= 0x40;
+	failures += check_load("check.meshbin", data, size, -1);
+	data[size - 1] ^= 0x40;
+	data[0] = 'X';
+	failures += check_load("check.meshbin", data, size, -1);
+	return failures;
+}
+
+#pragma mark -
+
+int check_mesh_io(void) {
+	strcpy(check_dir, "/tmp/check_mesh_io_XXXXXX");
+	if (!mkdtemp(check_dir)) {
+		fprintf(stderr, "mesh_io: could not make a temporary directory\n");
+		return 1;
+	}
+	int failures = 0;
+
+	// OBJ
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nf 1 2 4 3\n", 2);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\n", 1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1/1 2//2 3/3\n", 1);
+	failures += check_obj("", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4294967297\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 -4294967295\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 1 2\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2\n", -1);
+	failures += check_obj("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 x\n", -1);
+	failures += check_obj("v 1e400 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", -1);
+	failures += check_obj("v -1e39 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", -1);
+	failures += check_obj("v nan 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", -1);
+	failures += check_obj("v 0 0\n", -1);
+
+	// PLY
+	failures += check_ply_int("int", 2, 1);
+	failures += check_ply_int("uint", 2, 1);
+	failures += check_ply_int("int", 3, -1);
+	failures += check_ply_int("int", 0xFFFFFFFF, -1);
+	failures += check_ply_int("uint", 0xFFFFFFFF, -1);
+	failures += check_ply_int("uint", 0x80000001, -1);
+	failures += check_ply_float(2.0f, 0.0f, 1);
+	failures += check_ply_float(1.5f, 0.0f, -1);
+	failures += check_ply_float(-1.0f, 0.0f, -1);
+	failures += check_ply_float(3.0e9f, 0.0f, -1);
+	failures += check_ply_float(NAN, 0.0f, -1);
+	failures += check_ply_float(INFINITY, 0.0f, -1);
+	failures += check_ply_float(2.0f, INFINITY, -1);
+	failures += check_ply_float(2.0f, NAN, -1);
+	failures += check_ply_count("uchar", 3, 1);
+	failures += check_ply_count("uint", 3, 1);
+	failures += check_ply_count("uchar", 2, -1);
+	failures += check_ply_count("uchar", 4, -1);
+	failures += check_ply_count("uint", 0xFFFFFFFF, -1);
+	failures += check_ply_count("float", 3, -1);
+	failures += check_load("check.ply", "ply\nformat ascii 1.0\nend_header\n", 34, -1);
+	failures += check_load("check.ply", "ply\nformat binary_little_endian 1.0\n", 36, -1);
+
+	// Mesh binary
+	failures += check_meshbin();
+
+	rmdir(check_dir);
+	return failures;
+}
@@ -0,0 +1,49 @@
+//
+//  meshconv.c
+//  SDL_Xcode
+//
+//  Converts an OBJ or PLY file to the .meshbin format, which loads with
+//  one mmap. Builds without SDL:
+//  cc -std=gnu17 -O2 -DHEADLESS -ISDL_Xcode tools/meshconv.c $(ls SDL_Xcode/*.c | grep -v main.c) -lm -lpthread -o meshconv
+//
+
+#include "mesh_io.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+int main(int argc, const char * argv[]) {
+	// Usage: meshconv [-no-normalize] INPUT OUTPUT.meshbin
+	// The mesh is centered and scaled to the cube by default, as the viewer
+	// does for OBJ and PLY files, so the cache draws the same as its source
+	bool normalize = true;
+	int first = 1;
+	if (argc > 1 && strcmp(argv[1], "-no-normalize") == 0) {
+		normalize = false;
+		first++;
+	}
+	if (argc - first != 2) {
+		fprintf(stderr, "Usage: %s [-no-normalize] INPUT.obj|INPUT.ply OUTPUT.meshbin\n", argv[0]);
+		return 1;
+	}
+	const char *input = argv[first];
+	const char *output = argv[first + 1];
+	
+	mesh_t *mesh = mesh_load(input);
+	if (!mesh) return 1;
+	if (normalize) mesh_normalize(mesh);
+	bool ok = mesh_save_meshbin(mesh, output);
+	if (ok) {
+		fprintf(stdout, "Wrote %s: %d vertices, %d triangles.\n", output, mesh->vertex_count, mesh->face_count);
+	}
+	mesh_destroy(mesh);
+	
+	// Read the file back to check it
+	if (ok) {
+		mesh = mesh_load_meshbin(output);
+		ok = mesh != NULL;
+		if (mesh) mesh_destroy(mesh);
+	}
+	return ok? 0 : 1;
+}